@@ -7,6 +7,9 @@
 #include "Helper.h"
 #include "AudioDB.h"
 #include "ComponentDB.h"
+#include "Interner.h"
+#include "CollisionDB.h"
+#include "Profiler.h"
 
 #include <cmath>
 #include <iostream>
@@ -20,35 +23,26 @@ using luabridge::LuaRef;
 
 Actor::Actor(const rapidjson::Value& actor_in_A2, bool is_templ) : id(max_id++)
 {
+	t.set_owner(this);
 	init_structures();
 
 	if (state == nullptr) state = ComponentDB::get_state();
 
 	read_json_properties_A2(actor_in_A2);
-
-	//index components
-	for (size_t i = 0; i < components.size(); ++i) {
-		LuaRef& component = components[i];
-		index_component(component, i);
-	}
 }
 
-Actor::Actor(const Actor* templ) : id(max_id++)
+Actor::Actor(const Actor* templ) : id(max_id++), source_templ(templ)
 {
+	t.set_owner(this);
 	if (state == nullptr) state = ComponentDB::get_state();
 
 	if (templ != nullptr)
 		copy_properties(templ);
-
-	//index components
-	for (size_t i = 0; i < components.size(); ++i) {
-		LuaRef& component = components[i];
-		index_component(component, i);
-	}
 }
 
 Actor::Actor(const rapidjson::Value& actor_json) : id(max_id++)
 {
+	t.set_owner(this);
 	if (state == nullptr) state = ComponentDB::get_state();
 
 	int templ_idx = -1;
@@ -72,32 +66,74 @@ Actor::Actor(const rapidjson::Value& actor_json) : id(max_id++)
 	}
 
 	read_json_properties(actor_json, templ_idx);
+}
 
+Actor::~Actor()
+{
+	LuaHandles::release(this);
+	LuaHandles::release(&t);
+	t.detach();
 
-	//index components
-	for (size_t i = 0; i < components.size(); ++i) {
-		LuaRef& component = components[i];
-		index_component(component, i);
+	components.clear();
+	new_components.clear();
+
+	slots.clear();
+}
+
+luabridge::LuaRef Actor::get_component_by_key(const std::string& key)
+{
+	component_slot* slot = find_slot(key);
+	if (slot == nullptr) return luabridge::LuaRef(state);
+	return components[slot->idx];
+}
+
+luabridge::LuaRef Actor::get_component(const std::string& type)
+{
+	const luabridge::LuaRef* comp = find_component(Interner::find_id(type));
+	if (comp == nullptr) return luabridge::LuaRef(state);
+	return *comp;
+}
+
+const luabridge::LuaRef* Actor::find_component(uint32_t type_id) const
+{
+	if (type_id == Interner::INVALID_ID) return nullptr;
+
+	//first of this type in load order
+	size_t best = SIZE_MAX;
+	for (const component_slot& slot : slots) {
+		if (slot.type_id == type_id && !(slot.lifecycle & LIFECYCLE_REMOVED) && slot.idx < best)
+			best = slot.idx;
 	}
 
+	if (best == SIZE_MAX) return nullptr;
+	return &components[best];
 }
 
-Actor::~Actor()
+luabridge::LuaRef Actor::get_components(const std::string& type)
 {
-	components.clear();
-	new_components.clear();
+	luabridge::LuaRef ret_table = luabridge::newTable(state);
+
+	uint32_t type_id = Interner::find_id(type);
+	if (type_id == Interner::INVALID_ID) return ret_table;
 
-	components_by_key.clear();
-	components_by_type.clear();
-	components_with_start.clear();
-	components_with_update.clear();
-	components_with_late_update.clear();
+	//gather in load order
+	std::vector<uint32_t> idxs;
+	for (const component_slot& slot : slots) {
+		if (slot.type_id == type_id && !(slot.lifecycle & LIFECYCLE_REMOVED))
+			idxs.push_back(slot.idx);
+	}
+	std::sort(idxs.begin(), idxs.end());
+
+	for (size_t i = 0; i < idxs.size(); ++i) {
+		ret_table[i + 1] = components[idxs[i]];
+	}
+	return ret_table;
 }
 
 luabridge::LuaRef Actor::get_actor(const std::string& name) {
 	Actor* a = SceneDB::get_actor(name);
 	if (a == nullptr) return luabridge::LuaRef(state);
-	return luabridge::LuaRef(state, *a);
+	return luabridge::LuaRef(state, a);
 }
 luabridge::LuaRef Actor::get_actors(const std::string& name) {
 	luabridge::LuaRef ret_table = luabridge::newTable(state);
@@ -110,74 +146,229 @@ luabridge::LuaRef Actor::get_actors(const std::string& name) {
 
 luabridge::LuaRef Actor::cpp_add_component(const std::string& name)
 {
-	luabridge::LuaRef& comp = add_component(name, "r" + std::to_string(added_components++));
+	new_components.push_back(add_component(name, "r" + std::to_string(added_components++)));
 
-	new_components.push_back(comp);
-
-	return comp;
+	return new_components.back();
 }
 
 void Actor::cpp_remove_component(const luabridge::LuaRef& comp)
 {
 	//get and validate key
 	string key = comp["key"].tostring();
-	if (components_by_key.find(key) == components_by_key.end()) {
+	component_slot* slot = find_slot(key);
+	if (slot == nullptr) {
 		cout << "Error: tried to remove component from actor " << name << " which is not known (by key)";
 		exit(0);
 	}
-	components_by_key.erase(key);
-
-	//remove from life cycle functions
-	if (components_with_start.find(key) != components_with_start.end()) components_with_start.erase(key);
-	if (components_with_update.find(key) != components_with_update.end()) components_with_update.erase(key);
-	if (components_with_late_update.find(key) != components_with_late_update.end()) components_with_late_update.erase(key);
-
-	//find location in components by type and remove
-	bool removed = false;
-	for (int i = 0; i < components_by_type[comp["type"]].size(); ++i) {
-		size_t idx = components_by_type[comp["type"]][i];
-		if (components[idx]["key"] == key) {
-			components_by_type[comp["type"]].erase(components_by_type[comp["type"]].begin() + i);
-			removed = true;
+
+	//find location in components by type
+	string type = comp["type"].tostring();
+	if (slot->type_id != Interner::find_id(type)) {
+		cout << "Error: tried to remove component from actor " << name << " which is not known (by type)";
+		exit(0);
+	}
+
+	if (slot->lifecycle & LIFECYCLE_NATIVE)
+		detach_native(*slot);
+
+	//flag rather than erase so a component can remove itself (or a sibling) mid-callback
+	slot->lifecycle = LIFECYCLE_REMOVED;
+	has_removed = true;
+}
+
+void Actor::remove_all_components()
+{
+	for (component_slot& slot : slots) {
+		if (slot.lifecycle & LIFECYCLE_NATIVE)
+			detach_native(slot);
+		slot.lifecycle = LIFECYCLE_REMOVED;
+	}
+	has_removed = !slots.empty();
+}
+
+void Actor::set_asleep(bool val)
+{
+	if (activation.asleep == val) return;
+
+	activation.asleep = val;
+	if (val) run_function(LIFECYCLE_SLEEP, "OnSleep");
+	else run_function(LIFECYCLE_WAKE, "OnWake");
+}
+
+void Actor::on_collision(uint8_t collision_event, Actor* other)
+{
+	if (!listens_for(collision_event)) return;
+
+	const char* function = CollisionDB::EVENT_FUNCTIONS[collision_event];
+
+	for (size_t i = 0; i < slots.size(); ++i) {
+
+		//check in loop because components can set our active state
+		if (!active)
 			break;
+
+		if (!(slots[i].lifecycle & LIFECYCLE_COLLISION))
+			continue;
+
+		LuaRef& comp = components[slots[i].idx];
+
+		LuaRef func = comp[function];			//function ref
+		LuaRef enabled = comp["enabled"];		//component enabled state ref
+
+		try {
+			if (func.isFunction() && enabled.cast<bool>() == true) {
+				Profiler::zone zone(slots[i].type_id, function, this);
+				running_scope running(this);
+				func(comp, other);
+			}
+		}
+		catch (const luabridge::LuaException& e) {
+			report_error(name, e);
 		}
 	}
+}
 
+void Actor::on_animation_event(const std::string& event_name)
+{
+	for (size_t i = 0; i < slots.size(); ++i) {
 
-	if (!removed) {
-		cout << "Error: tried to remove component from actor " << name << " which is not known (by type)";
-		exit(0);
+		if (!active)
+			break;
+
+		if (slots[i].lifecycle & LIFECYCLE_REMOVED)
+			continue;
+
+		LuaRef& comp = components[slots[i].idx];
+
+		LuaRef func = comp["OnAnimationEvent"];
+		LuaRef enabled = comp["enabled"];
+
+		try {
+			if (func.isFunction() && enabled.cast<bool>() == true) {
+				Profiler::zone zone(slots[i].type_id, "OnAnimationEvent", this);
+				running_scope running(this);
+				func(comp, event_name);
+			}
+		}
+		catch (const luabridge::LuaException& e) {
+			report_error(name, e);
+		}
 	}
 }
 
-void Actor::remove_all_components()
+void Actor::attach_native_components()
+{
+	for (const component_slot& slot : slots) {
+		if (slot.lifecycle & LIFECYCLE_NATIVE)
+			attach_native(slot);
+	}
+}
+
+void Actor::detach_native_components()
+{
+	for (const component_slot& slot : slots) {
+		if (slot.lifecycle & LIFECYCLE_NATIVE)
+			detach_native(slot);
+	}
+}
+
+void Actor::set_sleep_offscreen(bool val)
+{
+	//destroyed: release_destroyed may already have unregistered it and would never see it again
+	if (!is_active()) return;
+
+	activation.enabled = val;
+
+	if (val) SceneDB::register_activation(this);
+	else SceneDB::unregister_activation(this);
+}
+
+void Actor::start_immediately()
+{
+	if (started || start_immediate) return;
+
+	start_immediate = true;
+	SceneDB::request_immediate_start();
+}
+
+void Actor::reset_to_template(const Actor* temp)
 {
-	for (luabridge::LuaRef& comp : components) {
-		cpp_remove_component(comp);
+	id = max_id++;
+	name = temp->name;
+	templ = temp->name;
+	scene_persist = false;
+	active = true;
+	started = false;
+	start_immediate = false;
+	activation = activation_state();
+	activation.enabled = temp->activation.enabled;
+	t.reset();
+
+	//drop anything added at runtime; the first components always mirror the template's
+	new_components.clear();
+	components.erase(components.begin() + temp->components.size(), components.end());
+	slots.clear();
+	has_removed = false;
+	collision_listeners = 0;
+
+	for (size_t i = 0; i < components.size(); ++i) {
+		LuaRef& comp = components[i];
+
+		//clear every field set on the instance so reads fall through to the template again (lua allows clearing fields mid-traversal)
+		comp.push(state);
+		int table_idx = lua_gettop(state);
+		lua_pushnil(state);
+		while (lua_next(state, table_idx) != 0) {
+			lua_pop(state, 1);
+			lua_pushvalue(state, -1);
+			lua_pushnil(state);
+			lua_rawset(state, table_idx);
+		}
+		lua_pop(state, 1);
+
+		comp["actor"] = this;
+		comp["Transform"] = &t;
+
+		index_component(comp, i);
 	}
 }
 
+size_t Actor::get_footprint() const
+{
+	return sizeof(Actor)
+		+ name.capacity() + templ.capacity()
+		+ components.capacity() * sizeof(luabridge::LuaRef)
+		+ new_components.capacity() * sizeof(luabridge::LuaRef)
+		+ slots.capacity() * sizeof(component_slot);
+}
+
 
 /* ------------------------ private ------------------------ */
 
-void Actor::run_function(std::map<std::string, size_t>& component_idxs, std::string function)
+void Actor::run_function(uint8_t lifecycle_bit, const char* function)
 {
-	/* Call function */
-	for (const auto& pair : component_idxs) {
+	/* Call function (by idx since callbacks may flag slots as removed) */
+	for (size_t i = 0; i < slots.size(); ++i) {
 
 		//check in loop because components can set our active state
 		if (!active)
 			break;
 
-		LuaRef comp = components[pair.second];
+		if (!(slots[i].lifecycle & lifecycle_bit))
+			continue;
+
+		LuaRef& comp = components[slots[i].idx];
 
 		LuaRef func = comp[function];			//function ref
 		LuaRef enabled = comp["enabled"];		//component enabled state ref
 
 		try {
 			// if component enabled, call OnUpdate()
-			if (enabled.cast<bool>() == true)
+			if (enabled.cast<bool>() == true) {
+				Profiler::zone zone(slots[i].type_id, function, this);
+				running_scope running(this);
 				func(comp);
+			}
 		}
 		catch (const luabridge::LuaException& e) {
 			report_error(name, e);
@@ -185,8 +376,83 @@ void Actor::run_function(std::map<std::string, size_t>& component_idxs, std::str
 	}
 }
 
+void Actor::update(uint32_t frame, float now)
+{
+	if (!started || activation.asleep) return;
+
+	for (size_t i = 0; i < slots.size(); ++i) {
+
+		//check in loop because components can set our active state
+		if (!active)
+			break;
+
+		component_slot& slot = slots[i];
+		if (!(slot.lifecycle & LIFECYCLE_UPDATE))
+			continue;
+
+		LuaRef& comp = components[slot.idx];
+
+		if (slot.update_interval == 0)
+			resolve_schedule(slot, comp);
+
+		//not this component's frame
+		if (slot.update_interval > 1 && frame % slot.update_interval != slot.update_phase)
+			continue;
+
+		//real time since this component last ran (first run assumes one full interval)
+		float dt = slot.last_update < 0.f ? SceneDB::get_frame_dt() * slot.update_interval : now - slot.last_update;
+
+		LuaRef func = comp["OnUpdate"];			//function ref
+		LuaRef enabled = comp["enabled"];		//component enabled state ref
+
+		try {
+			if (enabled.cast<bool>() == true) {
+				slot.last_update = now;
+				Profiler::zone zone(slot.type_id, "OnUpdate", this);
+				running_scope running(this);
+				func(comp, dt);
+			}
+		}
+		catch (const luabridge::LuaException& e) {
+			report_error(name, e);
+		}
+	}
+}
+
+void Actor::resolve_schedule(component_slot& slot, const luabridge::LuaRef& comp)
+{
+	//update_interval is in frames, update_rate in Hz; either may come from the component type or from json
+	int interval = 1;
+	LuaRef frames = comp["update_interval"];
+	LuaRef hz = comp["update_rate"];
+	if (frames.isNumber())
+		interval = static_cast<int>(frames.cast<float>() + 0.5f);
+	else if (hz.isNumber() && hz.cast<float>() > 0.f)
+		interval = static_cast<int>(TARGET_FPS / hz.cast<float>() + 0.5f);
+
+	interval = std::clamp(interval, 1, static_cast<int>(UINT16_MAX));
+
+	slot.update_interval = static_cast<uint16_t>(interval);
+	slot.update_phase = static_cast<uint16_t>(SceneDB::next_update_phase(interval));
+}
+
+void Actor::clear_lifecycle(uint8_t lifecycle_bit)
+{
+	for (component_slot& slot : slots) {
+		slot.lifecycle &= ~lifecycle_bit;
+	}
+}
+
 void Actor::insert_new_components()
 {
+	if (has_removed) {
+		slots.erase(std::remove_if(slots.begin(), slots.end(),
+			[](const component_slot& slot) { return (slot.lifecycle & LIFECYCLE_REMOVED) != 0; }), slots.end());
+		has_removed = false;
+	}
+
+	if (new_components.empty()) return;
+
 	for (auto& comp : new_components) {
 		size_t i = components.size();
 		components.push_back(comp);
@@ -196,27 +462,109 @@ void Actor::insert_new_components()
 	new_components.clear();
 }
 
-void Actor::index_component(luabridge::LuaRef& comp, size_t i)
+void Actor::index_component(const luabridge::LuaRef& comp, size_t i)
 {
-	string key = comp["key"];
-	string type = comp["type"];
-
-
-	components_by_key.emplace(key, i);
-	components_by_type[type].emplace_back(i);
+	component_slot slot;
+	slot.key_id = key_to_id(comp["key"].tostring());
+	slot.type_id = Interner::get_id(comp["type"].tostring());
+	slot.idx = static_cast<uint32_t>(i);
+	slot.lifecycle = 0;
+	slot.update_interval = 0;
+	slot.update_phase = 0;
+	slot.last_update = -1.f;
 
 	if (comp["OnStart"].isFunction())
-		components_with_start.emplace(key, i);
+		slot.lifecycle |= LIFECYCLE_START;
 	if (comp["OnUpdate"].isFunction())
-		components_with_update.emplace(key, i);
+		slot.lifecycle |= LIFECYCLE_UPDATE;
 	if (comp["OnLateUpdate"].isFunction())
-		components_with_late_update.emplace(key, i);
+		slot.lifecycle |= LIFECYCLE_LATE_UPDATE;
+	if (comp["OnSleep"].isFunction())
+		slot.lifecycle |= LIFECYCLE_SLEEP;
+	if (comp["OnWake"].isFunction())
+		slot.lifecycle |= LIFECYCLE_WAKE;
+	for (uint8_t e = 0; e < CollisionDB::EVENT_COUNT; ++e) {
+		if (comp[CollisionDB::EVENT_FUNCTIONS[e]].isFunction()) {
+			slot.lifecycle |= LIFECYCLE_COLLISION;
+			collision_listeners |= 1 << e;
+		}
+	}
+	if (ComponentDB::is_native_type(slot.type_id))
+		slot.lifecycle |= LIFECYCLE_NATIVE;
+
+	//keep slots ordered by key so lifecycle functions run alphabetically by key
+	string key = id_to_key(slot.key_id);
+	auto it = std::lower_bound(slots.begin(), slots.end(), key,
+		[](const component_slot& s, const string& k) { return id_to_key(s.key_id) < k; });
+
+	//a key is only ever indexed once (later json for the same key overrides the existing table)
+	if (it != slots.end() && it->key_id == slot.key_id && !(it->lifecycle & LIFECYCLE_REMOVED))
+		return;
+
+	slots.insert(it, slot);
+
+	//components added to an actor already in the scene join the simulation right away
+	if (indexed && (slot.lifecycle & LIFECYCLE_NATIVE))
+		attach_native(slot);
+}
+
+void Actor::attach_native(const component_slot& slot)
+{
+	LuaRef& comp = components[slot.idx];
+	if (!comp["native_id"].isNil()) return;
+
+	uint32_t handle = ComponentDB::attach_native(slot.type_id, this, comp);
+	comp["native_id"] = handle;
+}
+
+void Actor::detach_native(const component_slot& slot)
+{
+	LuaRef& comp = components[slot.idx];
+	LuaRef handle = comp["native_id"];
+	if (!handle.isNumber()) return;
+
+	ComponentDB::detach_native(slot.type_id, handle.cast<uint32_t>());
+	comp["native_id"] = luabridge::Nil();
+}
+
+Actor::component_slot* Actor::find_slot(const std::string& key)
+{
+	uint32_t key_id = key_to_id(key, false);
+	if (key_id == Interner::INVALID_ID) return nullptr;
+
+	for (component_slot& slot : slots) {
+		if (slot.key_id == key_id && !(slot.lifecycle & LIFECYCLE_REMOVED))
+			return &slot;
+	}
+	return nullptr;
+}
+
+uint32_t Actor::key_to_id(const std::string& key, bool intern)
+{
+	//"r" followed by up to 9 digits, no leading zero
+	bool is_auto = key.size() >= 2 && key.size() <= 10 && key[0] == 'r' && (key[1] != '0' || key.size() == 2);
+	for (size_t i = 1; is_auto && i < key.size(); ++i) {
+		if (key[i] < '0' || key[i] > '9') is_auto = false;
+	}
+
+	if (is_auto)
+		return AUTO_KEY_BIT | static_cast<uint32_t>(std::stoul(key.substr(1)));
+
+	return intern ? Interner::get_id(key) : Interner::find_id(key);
+}
+
+std::string Actor::id_to_key(uint32_t key_id)
+{
+	if (key_id & AUTO_KEY_BIT)
+		return "r" + std::to_string(key_id & ~AUTO_KEY_BIT);
+	return Interner::get_string(key_id);
 }
 
 void Actor::copy_properties(const Actor* other)
 {
 	name = other->name;
 	templ = other->name;
+	activation.enabled = other->activation.enabled;
 
 	/* copy components from other by key rather than by direct copy (just in case) */
 	for (size_t i = 0; i < other->components.size(); ++i) {
@@ -231,11 +579,10 @@ void Actor::copy_properties(const Actor* other)
 		
 		ComponentDB::inherit(new_ref, r);
 
-		string new_key = new_ref["key"].tostring();
-		string new_type = new_ref["type"];
+		new_ref["actor"] = this;
+		new_ref["Transform"] = &t;
 
-		components_by_key.emplace(new_key, i);
-		components_by_type[new_type].emplace_back(i);
+		index_component(new_ref, components.size() - 1);
 	}
 }
 
@@ -244,6 +591,9 @@ void Actor::read_json_properties_A2(const rapidjson::Value& actor_in)
 	if (actor_in.HasMember("name") && actor_in["name"].IsString())
 		name = actor_in["name"].GetString();
 
+	if (actor_in.HasMember("sleep_when_offscreen") && actor_in["sleep_when_offscreen"].IsBool())
+		activation.enabled = actor_in["sleep_when_offscreen"].GetBool();
+
 	/* read in component json data if it exists (it might not if the actor purely inherits) */
 	if (actor_in.HasMember("components") && actor_in["components"].IsObject()) {
 
@@ -252,14 +602,15 @@ void Actor::read_json_properties_A2(const rapidjson::Value& actor_in)
 			LuaRef* ref;
 			string key = component.name.GetString();
 			string type = "";
+			component_slot* slot = find_slot(key);
 
 			//if inherited from parent template, don't make new component, copy from parent
 
 			if (component.value.IsObject() && component.value.GetObject().HasMember("type") && component.value.GetObject()["type"].IsString()) {
 				type = component.value.GetObject()["type"].GetString();
 			}
-			else if (components[components_by_key[key]]["type"].isString()) {
-				type = components[components_by_key[key]]["type"].tostring();
+			else if (slot != nullptr && components[slot->idx]["type"].isString()) {
+				type = components[slot->idx]["type"].tostring();
 			}
 			else {
 				cout << "undefined behevior in actor declaration";
@@ -268,18 +619,20 @@ void Actor::read_json_properties_A2(const rapidjson::Value& actor_in)
 
 
 			//new component
-			if (components_by_key.count(key) == 0) {
-				ref = &(add_component(type, key));
+			if (slot == nullptr) {
+				components.push_back(add_component(type, key));
+				index_component(components.back(), components.size() - 1);
+				ref = &(components.back());
 			}
 			//overwriting inherited component
 			else {
-				ref = &(components[components_by_key[key]]);
+				ref = &(components[slot->idx]);
 			}
 
 			ComponentDB::read_component_json_A2(ref, component.value);
 
 			(*ref)["actor"] = this;
-			(*ref)["Transform"] = t;
+			(*ref)["Transform"] = &t;
 		}
 
 	}
@@ -304,12 +657,13 @@ void Actor::read_json_properties(const rapidjson::Value& actor_json, int templ_i
 			LuaRef* ref;
 			string type = prop["name"].GetString();
 			string key = "r" + std::to_string(added_components++);
+			component_slot* slot = find_slot(key);
 
 			if (prop.HasMember("name") && prop["name"].IsString()) {
 				type = prop["name"].GetString();
 			}
-			else if (components[components_by_key[key]]["type"].isString()) {
-				type = components[components_by_key[key]]["type"].tostring();
+			else if (slot != nullptr && components[slot->idx]["type"].isString()) {
+				type = components[slot->idx]["type"].tostring();
 			}
 			else {
 				cout << "undefined behevior in actor declaration";
@@ -318,28 +672,27 @@ void Actor::read_json_properties(const rapidjson::Value& actor_json, int templ_i
 
 
 			//new component
-			if (components_by_key.count(key) == 0) {
-				ref = &(add_component(type, key));
+			if (slot == nullptr) {
+				components.push_back(add_component(type, key));
+				index_component(components.back(), components.size() - 1);
+				ref = &(components.back());
 			}
 			//overwriting inherited component
 			else {
-				ref = &(components[components_by_key[key]]);
+				ref = &(components[slot->idx]);
 			}
 
 			ComponentDB::read_component_json(ref, prop);
 
 			(*ref)["actor"] = this;
-			(*ref)["Transform"] = t;
+			(*ref)["Transform"] = &t;
 		}
 	}
 }
 
-luabridge::LuaRef& Actor::add_component(const std::string& type, const std::string& key)
+luabridge::LuaRef Actor::add_component(const std::string& type, const std::string& key)
 {
-	size_t i = components.size();
-
-	components.emplace_back(luabridge::newTable(state));
-	luabridge::LuaRef& ref = components.back();
+	luabridge::LuaRef ref = luabridge::newTable(state);
 
 	ComponentDB::get_component(ref, type);
 
@@ -366,9 +719,5 @@ void Actor::init_structures()
 	components = std::vector<luabridge::LuaRef>();
 	new_components = std::vector<luabridge::LuaRef>();
 
-	components_by_key = std::map<std::string, size_t>();
-	components_by_type = std::map<std::string, std::vector<size_t>>();
-	components_with_start = std::map<std::string, size_t>();
-	components_with_update = std::map<std::string, size_t>();
-	components_with_late_update = std::map<std::string, size_t>();
+	slots = std::vector<component_slot>();
 }
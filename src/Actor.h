@@ -18,6 +18,7 @@
 #include "SDL2/SDL.h"
 #include "Lua/lua.hpp"
 #include "LuaBridge/LuaBridge.h"
+#include "LuaHandles.h"
 
 #include <vector>
 #include <optional>
@@ -25,6 +26,7 @@
 #include <unordered_map>
 #include <map>
 #include <memory>
+#include <cstdint>
 
 #include "Transform.h"
 
@@ -45,46 +47,88 @@ public:
 	~Actor();
 
 	void start() { 
-		run_function(components_with_start, "OnStart"); 
-		components_with_start.clear();
+		run_function(LIFECYCLE_START, "OnStart"); 
+		clear_lifecycle(LIFECYCLE_START);
+		started = true;
 	}
-	void update() { run_function(components_with_update, "OnUpdate"); }
+	//runs OnUpdate(self, dt) for components due this frame (see SceneDB::tick for the schedule)
+	void update(uint32_t frame, float now);
 	void late_update() { 
-		run_function(components_with_late_update, "OnLateUpdate");
+		if (started && !activation.asleep) run_function(LIFECYCLE_LATE_UPDATE, "OnLateUpdate");
 		insert_new_components();
 	}
 
+	//flips the sleep state, running OnSleep / OnWake if it changed
+	void set_asleep(bool val);
+
+	//runs CollisionDB::EVENT_FUNCTIONS[collision_event](self, other) on every component that defines it
+	void on_collision(uint8_t collision_event, Actor* other);
+	bool listens_for(uint8_t collision_event) const { return (collision_listeners & (1 << collision_event)) != 0; }
+
+	//calls OnAnimationEvent(name) on each enabled component that defines it (AnimationDB marked frames)
+	void on_animation_event(const std::string& event_name);
+
+	//hands native components (colliders, sprite renderers) their C++ data while we are in the scene (see SceneDB::index_actor)
+	void attach_native_components();
+	void detach_native_components();
+
+	bool has_started() const { return started; }
+
+	//asks SceneDB to start this actor on the next tick, ahead of the per-frame start budget
+	void start_immediately();
+	bool wants_immediate_start() const { return start_immediate; }
+
 	luabridge::LuaRef get_name() { 
 		return luabridge::LuaRef(state, name); 
 	}
 	luabridge::LuaRef get_id() { return luabridge::LuaRef(state, id); }
-	luabridge::LuaRef get_component_by_key(const std::string& key) {
-		if (components_by_key.count(key) != 0) return components[components_by_key[key]];
-		else return luabridge::LuaRef(state);
-	}
-	luabridge::LuaRef get_component(const std::string& type) {
-		if (components_by_type.count(type) != 0 && !components_by_type[type].empty()) return components[components_by_type[type][0]];
-		else return luabridge::LuaRef(state);
-	}
-	luabridge::LuaRef get_components(const std::string& type) {
-		luabridge::LuaRef ret_table = luabridge::newTable(state);
-		if (components_by_type.count(type) != 0) {
-			for (size_t i = 0; i < components_by_type[type].size(); ++i) {
-				ret_table[i + 1] = components[components_by_type[type][i]];
-			}
-		}
-		return ret_table;
-	}
+	luabridge::LuaRef get_component_by_key(const std::string& key);
+	luabridge::LuaRef get_component(const std::string& type);
+	//first component of type_id in load order, or nullptr (no LuaRef copy, for the raw Actor:GetComponent)
+	const luabridge::LuaRef* find_component(uint32_t type_id) const;
+	luabridge::LuaRef get_components(const std::string& type);
 
 	static luabridge::LuaRef get_actor(const std::string& name);
 	static luabridge::LuaRef get_actors(const std::string& name);
 
+	//the actor whose script callback is running, or nullptr; Timers, Event subscriptions and Coroutines created
+	//without an explicit owner belong to it, so they end when it is destroyed
+	static Actor* get_running() { return running; }
+
+	//marks an actor as running for one callback; nests, and restores the outer one when a callback throws
+	class running_scope {
+	public:
+		explicit running_scope(Actor* a) : prev(running) { running = a; }
+		~running_scope() { running = prev; }
+		running_scope(const running_scope&) = delete;
+		running_scope& operator=(const running_scope&) = delete;
+	private:
+		Actor* prev;
+	};
+
 	luabridge::LuaRef cpp_add_component(const std::string& name);
 	void cpp_remove_component(const luabridge::LuaRef& comp);
 
 	void remove_all_components();
 
+	//approximate native bytes owned by this actor (excludes the lua tables themselves)
+	size_t get_footprint() const;
+
+	//returns this actor to the state of a fresh Actor(temp): new id, template components only, template defaults
+	void reset_to_template(const Actor* temp);
+
+	//template this actor was instantiated from, or nullptr for scene and template actors
+	const Actor* get_source_template() const { return source_templ; }
+
+	//opts this actor in or out of sleeping while away from the camera (see SceneDB::update_activation)
+	void set_sleep_offscreen(bool val);
+
+	//world position (the transform's position is relative to its parent)
+	glm::vec2 get_position() const { return t.get_world_position(); }
+	Transform& get_transform() { return t; }
+
 	void set_active(bool val) { active = val; }
+	bool is_active() const { return active; }
 	
 	std::string name = "";
 	std::string templ = "";
@@ -93,37 +137,88 @@ public:
 
 	int id = -1;
 
-private:
-	static inline lua_State* state = nullptr;
+	//camera-proximity sleeping, driven by SceneDB
+	struct activation_state {
+		bool enabled = false;			//opted in (template "sleep_when_offscreen" or SetSleepWhenOffscreen)
+		bool registered = false;		//tracked in SceneDB's activation grid
+		bool asleep = false;
+		glm::ivec2 cell = { 0, 0 };		//grid cell we are currently bucketed in
+		uint32_t idx = 0;				//position in SceneDB::activation_actors while registered
+	};
+	activation_state activation;
 
-	std::vector<luabridge::LuaRef> new_components;	//new components as pair of <key, component>
+	//row key for per-actor data in ComponentStore, valid while indexed
+	uint32_t store_slot = UINT32_MAX;
 
-	std::vector<luabridge::LuaRef> components;							//components ordered by load order
-	std::map<std::string, size_t> components_by_key;					//component idxs ordered by key alphabetically
-	std::map<std::string, std::vector<size_t>> components_by_type;		//component idxs ordered by type, then key alphabetically
+	//SceneDB's spatial query index
+	bool indexed = false;
+	glm::ivec2 index_cell = { 0, 0 };
+	bool move_queued = false;			//in SceneDB's moved list, waiting to be re-bucketed
 
-	std::map<std::string, size_t> components_with_start;				//component idxs with OnStart defined, ordered by key
-	std::map<std::string, size_t> components_with_update;				//component idxs with OnUpdate defined, ordered by key
-	std::map<std::string, size_t> components_with_late_update;			//component idxs with OnStart defined, ordered by key
+private:
+	static inline lua_State* state = nullptr;
+	static inline Actor* running = nullptr;
+
+	//bits for component_slot::lifecycle
+	static inline const uint8_t LIFECYCLE_START = 1 << 0;
+	static inline const uint8_t LIFECYCLE_UPDATE = 1 << 1;
+	static inline const uint8_t LIFECYCLE_LATE_UPDATE = 1 << 2;
+	static inline const uint8_t LIFECYCLE_SLEEP = 1 << 3;
+	static inline const uint8_t LIFECYCLE_WAKE = 1 << 4;
+	static inline const uint8_t LIFECYCLE_COLLISION = 1 << 5;		//defines at least one collision / trigger callback
+	static inline const uint8_t LIFECYCLE_NATIVE = 1 << 6;			//type registered with ComponentDB::register_native_type
+	static inline const uint8_t LIFECYCLE_REMOVED = 1 << 7;		//slot is dropped at the next insert_new_components()
+
+	//generated keys ("r<n>") are stored by number rather than interned so destroyed actors leave nothing behind
+	static inline const uint32_t AUTO_KEY_BIT = 0x80000000u;
+
+	struct component_slot {
+		uint32_t key_id;			//interned key, or AUTO_KEY_BIT | n for generated keys
+		uint32_t type_id;			//interned type
+		uint32_t idx;				//idx into components (only grows: removed components keep their place)
+		uint8_t lifecycle;			//LIFECYCLE_* bits
+		uint16_t update_interval;	//run OnUpdate every n frames, 0 until first read from the component
+		uint16_t update_phase;		//frame % update_interval on which OnUpdate runs
+		float last_update;			//SceneDB time of the last OnUpdate, < 0 if never run
+	};
+
+	std::vector<luabridge::LuaRef> new_components;	//components added this frame, indexed at the end of late_update
+
+	std::vector<luabridge::LuaRef> components;		//components ordered by load order
+	std::vector<component_slot> slots;				//index over components, ordered by key alphabetically
+	bool has_removed = false;						//some slot is flagged LIFECYCLE_REMOVED
+	uint8_t collision_listeners = 0;				//bit per CollisionDB event some component may handle (never cleared on removal)
 
 	Transform t;
 
+	const Actor* source_templ = nullptr;
+
 	bool active = true;
+	bool started = false;				//OnStart has run for the components we were created with
+	bool start_immediate = false;
 	static inline int max_id = 0;
 	static inline int added_components = 0;
 
-	void run_function(std::map<std::string, size_t>& component_idxs, std::string function);
+	void run_function(uint8_t lifecycle_bit, const char* function);
+	void clear_lifecycle(uint8_t lifecycle_bit);
+	void resolve_schedule(component_slot& slot, const luabridge::LuaRef& comp);
 
 	void init_structures();
 	void insert_new_components();
-	void index_component(luabridge::LuaRef& comp, size_t i);
+	void index_component(const luabridge::LuaRef& comp, size_t i);
+	void attach_native(const component_slot& slot);
+	void detach_native(const component_slot& slot);
+	component_slot* find_slot(const std::string& key);
+
+	static uint32_t key_to_id(const std::string& key, bool intern = true);
+	static std::string id_to_key(uint32_t key_id);
 
 	void copy_properties(const Actor* other);
 
 	void read_json_properties_A2(const rapidjson::Value& actor_in);
 	void read_json_properties(const rapidjson::Value& actor_json, int templ_idx);
 
-	luabridge::LuaRef& add_component(const std::string& type, const std::string& key);
+	luabridge::LuaRef add_component(const std::string& type, const std::string& key);
 
 	static void report_error(std::string& name, const luabridge::LuaException& e);
 
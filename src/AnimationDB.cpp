@@ -0,0 +1,415 @@
+#include "AnimationDB.h"
+
+#include "Actor.h"
+#include "Consts.h"
+#include "ImageDB.h"
+#include "Interner.h"
+#include "ComponentDB.h"
+#include "EngineUtils.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void AnimationDB::add_component_types(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Animation")
+		.addFunction("Play", &AnimationDB::play)
+		.addFunction("Stop", &AnimationDB::stop)
+		.endNamespace();
+
+	LuaRef animation = luabridge::getGlobal(state, "Animation");
+	LuaRef play_function = animation["Play"];
+	LuaRef stop_function = animation["Stop"];
+
+	ComponentDB::native_type animator_type;
+	animator_type.attach = &AnimationDB::attach;
+	animator_type.detach = &AnimationDB::detach;
+
+	animator_type.fields = {
+		{ "animation", {
+			[](lua_State* L, uint32_t h) {
+				uint32_t sheet = animators.sheet[index.row_of(h)];
+				lua_pushstring(L, sheet == NO_SHEET ? "" : Interner::get_string(sheets[sheet].name).c_str());
+			},
+			[](lua_State* L, uint32_t h, int idx) {
+				uint32_t row = index.row_of(h);
+				std::string name = luaL_checkstring(L, idx);
+				animators.sheet[row] = name.empty() ? NO_SHEET : get_sheet(name);
+				set_clip(row, 0);
+			} } },
+		{ "clip", {
+			[](lua_State* L, uint32_t h) {
+				uint32_t row = index.row_of(h);
+				uint32_t sheet = animators.sheet[row];
+				lua_pushstring(L, sheet == NO_SHEET ? "" : Interner::get_string(sheets[sheet].clips[animators.clip[row]].name).c_str());
+			},
+			[](lua_State* L, uint32_t h, int idx) {
+				uint32_t row = index.row_of(h);
+				set_clip(row, find_clip(animators.sheet[row], luaL_checkstring(L, idx)));
+			} } },
+		{ "frame", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, animators.frame[index.row_of(h)]); },
+			[](lua_State* L, uint32_t h, int idx) {
+				uint32_t row = index.row_of(h);
+				if (animators.sheet[row] == NO_SHEET) return;
+
+				size_t count = sheets[animators.sheet[row]].clips[animators.clip[row]].frames.size();
+				lua_Integer frame = static_cast<lua_Integer>(luaL_checknumber(L, idx));
+				animators.frame[row] = static_cast<uint32_t>(std::clamp<lua_Integer>(frame, 0, static_cast<lua_Integer>(count) - 1));
+				animators.time[row] = 0.f;
+				animators.dirty[row] = 1;
+			} } },
+		{ "speed", {
+			[](lua_State* L, uint32_t h) { lua_pushnumber(L, animators.speed[index.row_of(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { animators.speed[index.row_of(h)] = static_cast<float>(luaL_checknumber(L, idx)); } } },
+		{ "playing", {
+			[](lua_State* L, uint32_t h) { lua_pushboolean(L, animators.playing[index.row_of(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { animators.playing[index.row_of(h)] = lua_toboolean(L, idx) ? 1 : 0; } } },
+		{ "enabled", {
+			[](lua_State* L, uint32_t h) { lua_pushboolean(L, animators.enabled[index.row_of(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { animators.enabled[index.row_of(h)] = lua_toboolean(L, idx) ? 1 : 0; } } },
+	};
+
+	LuaRef animator = luabridge::newTable(state);
+	animator["animation"] = std::string();
+	animator["clip"] = std::string();
+	animator["frame"] = 0;
+	animator["speed"] = 1.f;
+	animator["playing"] = true;
+	animator["enabled"] = true;
+	animator["Play"] = play_function;
+	animator["Stop"] = stop_function;
+	ComponentDB::register_native_type("Animator", animator, animator_type);
+}
+
+void AnimationDB::update(float dt)
+{
+	frames_advanced = 0;
+
+	for (uint32_t row = 0; row < animators.actor.size(); ++row) {
+		if (!animators.enabled[row] || animators.sheet[row] == NO_SHEET) continue;
+
+		const Actor* a = animators.actor[row];
+		if (!a->is_active() || !a->has_started() || a->activation.asleep) continue;
+
+		const clip& c = sheets[animators.sheet[row]].clips[animators.clip[row]];
+
+		if (animators.dirty[row]) {
+			animators.dirty[row] = 0;
+			enter_frame(row);
+		}
+		if (!animators.playing[row] || animators.speed[row] <= 0.f) continue;
+
+		float& time = animators.time[row];
+		time += dt * animators.speed[row];
+
+		while (time >= c.durations[animators.frame[row]]) {
+			time -= c.durations[animators.frame[row]];
+			if (!advance(row, c)) {
+				animators.playing[row] = 0;
+				time = 0.f;
+				break;
+			}
+			enter_frame(row);
+			++frames_advanced;
+		}
+	}
+
+	if (events.empty()) return;
+
+	//callbacks may play clips and queue more events; those go out next frame
+	std::vector<std::pair<Actor*, uint32_t>> delivering;
+	delivering.swap(events);
+	for (const std::pair<Actor*, uint32_t>& e : delivering) {
+		e.first->on_animation_event(Interner::get_string(e.second));
+	}
+}
+
+void AnimationDB::play(const luabridge::LuaRef& comp, const std::string& clip_name)
+{
+	uint32_t row = row_of(comp);
+	if (row == DenseIndex::NONE) {
+		//not in the scene yet; attach picks these up
+		LuaRef table = comp;
+		table["clip"] = clip_name;
+		table["playing"] = true;
+		return;
+	}
+
+	set_clip(row, find_clip(animators.sheet[row], clip_name));
+	animators.playing[row] = 1;
+}
+
+void AnimationDB::stop(const luabridge::LuaRef& comp)
+{
+	uint32_t row = row_of(comp);
+	if (row == DenseIndex::NONE) {
+		LuaRef table = comp;
+		table["playing"] = false;
+		return;
+	}
+
+	animators.playing[row] = 0;
+}
+
+void AnimationDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("animators", static_cast<double>(index.size()));
+	out.emplace_back("animation_sheets", static_cast<double>(sheets.size()));
+	out.emplace_back("animation_frames_advanced", static_cast<double>(frames_advanced));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+uint32_t AnimationDB::attach(Actor* a, luabridge::LuaRef& comp)
+{
+	uint32_t handle;
+	if (!free_handles.empty()) {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+	else {
+		handle = next_handle++;
+	}
+
+	LuaRef animation = comp["animation"];
+	LuaRef clip_name = comp["clip"];
+	LuaRef speed = comp["speed"];
+	LuaRef playing = comp["playing"];
+	LuaRef enabled = comp["enabled"];
+
+	uint32_t sheet = NO_SHEET;
+	if (animation.isString() && !animation.tostring().empty())
+		sheet = get_sheet(animation.tostring());
+
+	uint32_t clip_idx = 0;
+	if (sheet != NO_SHEET && clip_name.isString() && !clip_name.tostring().empty())
+		clip_idx = find_clip(sheet, clip_name.tostring());
+
+	index.add(handle);
+	animators.actor.push_back(a);
+	animators.actor_slot.push_back(a->store_slot);
+	animators.sheet.push_back(sheet);
+	animators.clip.push_back(clip_idx);
+	animators.frame.push_back(0);
+	animators.time.push_back(0.f);
+	animators.speed.push_back(speed.isNumber() ? speed.cast<float>() : 1.f);
+	animators.direction.push_back(1);
+	animators.playing.push_back(playing.isBool() ? playing.cast<bool>() : 1);
+	animators.enabled.push_back(enabled.isBool() ? enabled.cast<bool>() : 1);
+	animators.dirty.push_back(1);
+
+	return handle;
+}
+
+void AnimationDB::detach(uint32_t handle)
+{
+	uint32_t row = index.remove(handle);
+	swap_remove(animators.actor, row);
+	swap_remove(animators.actor_slot, row);
+	swap_remove(animators.sheet, row);
+	swap_remove(animators.clip, row);
+	swap_remove(animators.frame, row);
+	swap_remove(animators.time, row);
+	swap_remove(animators.speed, row);
+	swap_remove(animators.direction, row);
+	swap_remove(animators.playing, row);
+	swap_remove(animators.enabled, row);
+	swap_remove(animators.dirty, row);
+
+	free_handles.push_back(handle);
+}
+
+uint32_t AnimationDB::row_of(const luabridge::LuaRef& comp)
+{
+	LuaRef handle = comp["native_id"];
+	if (!handle.isNumber()) return DenseIndex::NONE;
+	return index.row_of(handle.cast<uint32_t>());
+}
+
+uint32_t AnimationDB::get_sheet(const std::string& name)
+{
+	uint32_t name_id = Interner::get_id(name);
+	auto it = sheet_ids.find(name_id);
+	if (it != sheet_ids.end()) return it->second;
+
+	std::string path = ANIMATIONS_FOLDER_PATH + name + ".json";
+	if (!std::filesystem::exists(path)) {
+		cout << "error: missing animation " << name;
+		exit(0);
+	}
+
+	rapidjson::Document d;
+	EngineUtils::ReadJsonFile(path, d);
+
+	if (!d.HasMember("image") || !d["image"].IsString()) {
+		cout << "error: animation " << name << " has no image";
+		exit(0);
+	}
+
+	sheet s;
+	s.name = name_id;
+	s.image = Interner::get_id(d["image"].GetString());
+
+	//atlas: explicit rects; sheet: a grid of frame_width x frame_height cells, numbered row by row
+	if (d.HasMember("frames")) {
+		for (const rapidjson::Value& f : d["frames"].GetArray()) {
+			s.rects.push_back({ f["x"].GetInt(), f["y"].GetInt(), f["w"].GetInt(), f["h"].GetInt() });
+		}
+	}
+	else if (d.HasMember("frame_width") && d.HasMember("frame_height")) {
+		int fw = d["frame_width"].GetInt();
+		int fh = d["frame_height"].GetInt();
+		int w = 0, h = 0;
+		SDL_QueryTexture(ImageDB::get_image(d["image"].GetString()), NULL, NULL, &w, &h);
+
+		for (int y = 0; fw > 0 && fh > 0 && y + fh <= h; y += fh) {
+			for (int x = 0; x + fw <= w; x += fw) {
+				s.rects.push_back({ x, y, fw, fh });
+			}
+		}
+	}
+	if (s.rects.empty()) {
+		cout << "error: animation " << name << " defines no frames";
+		exit(0);
+	}
+
+	if (d.HasMember("clips")) {
+		for (const auto& member : d["clips"].GetObject()) {
+			const rapidjson::Value& cj = member.value;
+			clip c;
+			c.name = Interner::get_id(member.name.GetString());
+
+			if (cj.HasMember("frames")) {
+				for (const rapidjson::Value& f : cj["frames"].GetArray()) {
+					c.frames.push_back(f.GetUint());
+				}
+			}
+			else {
+				for (uint32_t i = 0; i < s.rects.size(); ++i) c.frames.push_back(i);
+			}
+
+			float frame_duration = cj.HasMember("frame_duration") ? cj["frame_duration"].GetFloat() : 0.1f;
+			for (size_t i = 0; i < c.frames.size(); ++i) {
+				if (c.frames[i] >= s.rects.size()) {
+					cout << "error: clip " << member.name.GetString() << " in animation " << name << " uses missing frame " << c.frames[i];
+					exit(0);
+				}
+
+				float duration = frame_duration;
+				if (cj.HasMember("durations") && i < cj["durations"].Size()) duration = cj["durations"][static_cast<rapidjson::SizeType>(i)].GetFloat();
+				c.durations.push_back(std::max(duration, 0.001f));
+			}
+
+			if (cj.HasMember("loop")) {
+				std::string mode = cj["loop"].GetString();
+				if (mode == "once") c.loop_mode = ONCE;
+				else if (mode == "ping_pong") c.loop_mode = PING_PONG;
+			}
+
+			if (cj.HasMember("events")) {
+				for (const rapidjson::Value& e : cj["events"].GetArray()) {
+					c.events.emplace_back(e["frame"].GetUint(), Interner::get_id(e["name"].GetString()));
+				}
+				std::sort(c.events.begin(), c.events.end());
+			}
+
+			if (c.frames.empty()) {
+				cout << "error: clip " << member.name.GetString() << " in animation " << name << " has no frames";
+				exit(0);
+			}
+			s.clips.push_back(std::move(c));
+		}
+	}
+	else {
+		//no clips: the whole sheet loops as one clip named "default"
+		clip c;
+		c.name = Interner::get_id("default");
+		for (uint32_t i = 0; i < s.rects.size(); ++i) {
+			c.frames.push_back(i);
+			c.durations.push_back(0.1f);
+		}
+		s.clips.push_back(std::move(c));
+	}
+
+	sheets.push_back(std::move(s));
+	uint32_t idx = static_cast<uint32_t>(sheets.size() - 1);
+	sheet_ids.emplace(name_id, idx);
+	return idx;
+}
+
+uint32_t AnimationDB::find_clip(uint32_t sheet_idx, const std::string& name)
+{
+	if (sheet_idx == NO_SHEET) {
+		cout << "error: played clip " << name << " on an Animator with no animation";
+		exit(0);
+	}
+
+	const sheet& s = sheets[sheet_idx];
+	uint32_t name_id = Interner::find_id(name);
+	for (uint32_t i = 0; i < s.clips.size(); ++i) {
+		if (s.clips[i].name == name_id) return i;
+	}
+
+	cout << "error: animation " << Interner::get_string(s.name) << " has no clip " << name;
+	exit(0);
+}
+
+void AnimationDB::set_clip(uint32_t row, uint32_t clip_idx)
+{
+	animators.clip[row] = clip_idx;
+	animators.frame[row] = 0;
+	animators.time[row] = 0.f;
+	animators.direction[row] = 1;
+	animators.dirty[row] = 1;
+}
+
+bool AnimationDB::advance(uint32_t row, const clip& c)
+{
+	uint32_t last = static_cast<uint32_t>(c.frames.size() - 1);
+	uint32_t& frame = animators.frame[row];
+
+	if (c.loop_mode == LOOP) {
+		frame = frame >= last ? 0 : frame + 1;
+	}
+	else if (c.loop_mode == ONCE) {
+		if (frame >= last) return false;
+		++frame;
+	}
+	else {
+		if (last == 0) return true;
+
+		int8_t& direction = animators.direction[row];
+		int next = static_cast<int>(frame) + direction;
+		if (next < 0 || next > static_cast<int>(last)) {
+			direction = -direction;
+			next = static_cast<int>(frame) + direction;
+		}
+		frame = static_cast<uint32_t>(next);
+	}
+	return true;
+}
+
+void AnimationDB::enter_frame(uint32_t row)
+{
+	const sheet& s = sheets[animators.sheet[row]];
+	const clip& c = s.clips[animators.clip[row]];
+	uint32_t frame = animators.frame[row];
+
+	uint32_t sprite = ComponentStore::find_sprite(animators.actor_slot[row]);
+	if (sprite != DenseIndex::NONE)
+		ComponentStore::set_sprite_frame(sprite, s.image, s.rects[c.frames[frame]]);
+
+	auto it = std::lower_bound(c.events.begin(), c.events.end(), std::make_pair(frame, 0u));
+	for (; it != c.events.end() && it->first == frame; ++it) {
+		events.emplace_back(animators.actor[row], it->second);
+	}
+}
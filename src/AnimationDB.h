@@ -0,0 +1,96 @@
+#ifndef ANIMATION_DB_H
+#define ANIMATION_DB_H
+
+#include "SDL2/SDL.h"
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+#include "ComponentStore.h"
+
+class Actor;
+
+//native Animator component: plays clips from sprite sheets (resources/animations/<name>.json) by pointing the
+//actor's SpriteRenderer at one frame rect at a time; frames marked with events call OnAnimationEvent(name)
+class AnimationDB
+{
+public:
+	static inline const uint8_t LOOP = 0;
+	static inline const uint8_t ONCE = 1;
+	static inline const uint8_t PING_PONG = 2;
+
+	//registers the Animator component type (and the Animation namespace) with ComponentDB
+	static void add_component_types(lua_State* state);
+
+	//advances every playing animator, updates its sprite, then delivers frame events
+	static void update(float dt);
+
+	//lua: animator:Play(clip) restarts clip from its first frame, animator:Stop() pauses on the current frame
+	static void play(const luabridge::LuaRef& comp, const std::string& clip);
+	static void stop(const luabridge::LuaRef& comp);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	struct clip {
+		uint32_t name;							//interned
+		std::vector<uint32_t> frames;			//indices into sheet::rects
+		std::vector<float> durations;			//seconds, per frame
+		uint8_t loop_mode = LOOP;
+		std::vector<std::pair<uint32_t, uint32_t>> events;	//(frame, interned event name), sorted by frame
+	};
+
+	struct sheet {
+		uint32_t name;
+		uint32_t image;
+		std::vector<SDL_Rect> rects;
+		std::vector<clip> clips;
+	};
+
+	struct animator_columns {
+		std::vector<Actor*> actor;
+		std::vector<uint32_t> actor_slot;
+		std::vector<uint32_t> sheet;			//index into sheets, NO_SHEET if unset
+		std::vector<uint32_t> clip;				//index into the sheet's clips
+		std::vector<uint32_t> frame;			//position within the clip
+		std::vector<float> time;				//seconds spent on the current frame
+		std::vector<float> speed;
+		std::vector<int8_t> direction;			//+1 / -1, flips for ping pong
+		std::vector<uint8_t> playing;
+		std::vector<uint8_t> enabled;
+		std::vector<uint8_t> dirty;				//frame changed outside update (play, seek, new clip)
+	};
+
+	static inline const uint32_t NO_SHEET = UINT32_MAX;
+
+	static inline std::vector<sheet> sheets;
+	static inline std::unordered_map<uint32_t, uint32_t> sheet_ids;		//interned name -> index into sheets
+
+	static inline std::vector<uint32_t> free_handles;
+	static inline uint32_t next_handle = 0;
+	static inline DenseIndex index;
+	static inline animator_columns animators;
+
+	static inline std::vector<std::pair<Actor*, uint32_t>> events;		//(actor, interned event name) waiting for delivery
+	static inline size_t frames_advanced = 0;
+
+	static uint32_t attach(Actor* a, luabridge::LuaRef& comp);
+	static void detach(uint32_t handle);
+	static uint32_t row_of(const luabridge::LuaRef& comp);
+
+	//loads resources/animations/<name>.json the first time it is asked for
+	static uint32_t get_sheet(const std::string& name);
+	static uint32_t find_clip(uint32_t sheet_idx, const std::string& name);
+
+	static void set_clip(uint32_t row, uint32_t clip_idx);
+	//moves row to its next frame; returns false when a ONCE clip has finished
+	static bool advance(uint32_t row, const clip& c);
+	static void enter_frame(uint32_t row);
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "CollisionDB.h"
+
+#include "Actor.h"
+#include "Interner.h"
+#include "ComponentDB.h"
+#include "ComponentStore.h"
+
+#include <algorithm>
+#include <tuple>
+#include <iostream>
+#include <cmath>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void CollisionDB::add_component_types(lua_State* state)
+{
+	box_type_id = Interner::get_id("BoxCollider");
+	circle_type_id = Interner::get_id("CircleCollider");
+
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Physics")
+		.addFunction("RefreshCollider", &CollisionDB::refresh_collider)
+		.endNamespace();
+
+	LuaRef refresh = luabridge::getGlobal(state, "Physics")["RefreshCollider"];
+
+	ComponentDB::native_type collider_type;
+	collider_type.attach = &CollisionDB::add_collider;
+	collider_type.detach = &CollisionDB::remove_collider;
+
+	//prototypes behave like component files: json / lua fields override these defaults
+	LuaRef box = luabridge::newTable(state);
+	box["width"] = 1.f;
+	box["height"] = 1.f;
+	box["offset_x"] = 0.f;
+	box["offset_y"] = 0.f;
+	box["is_trigger"] = false;
+	box["Refresh"] = refresh;
+	ComponentDB::register_native_type("BoxCollider", box, collider_type);
+
+	LuaRef circle = luabridge::newTable(state);
+	circle["radius"] = 0.5f;
+	circle["offset_x"] = 0.f;
+	circle["offset_y"] = 0.f;
+	circle["is_trigger"] = false;
+	circle["Refresh"] = refresh;
+	ComponentDB::register_native_type("CircleCollider", circle, collider_type);
+}
+
+uint32_t CollisionDB::add_collider(Actor* a, luabridge::LuaRef& comp)
+{
+	uint32_t handle;
+	if (!free_handles.empty()) {
+		handle = free_handles.back();
+		free_handles.pop_back();
+		colliders[handle] = collider(a, comp);
+	}
+	else {
+		handle = static_cast<uint32_t>(colliders.size());
+		colliders.emplace_back(a, comp);
+	}
+
+	collider& c = colliders[handle];
+	c.shape = Interner::find_id(comp["type"].tostring()) == circle_type_id ? SHAPE_CIRCLE : SHAPE_BOX;
+	read_shape(c);
+
+	sweep.push_back({ glm::vec2(0.f), glm::vec2(0.f), handle, false });
+	return handle;
+}
+
+void CollisionDB::remove_collider(uint32_t handle)
+{
+	if (handle >= colliders.size() || !colliders[handle].live) return;
+
+	//keep the slot (and its handle) reserved until step() has dropped its contacts
+	colliders[handle].live = false;
+	dead_handles.push_back(handle);
+}
+
+void CollisionDB::refresh_collider(const luabridge::LuaRef& comp)
+{
+	LuaRef handle = comp["native_id"];
+	if (!handle.isNumber()) return;
+
+	uint32_t h = handle.cast<uint32_t>();
+	if (h < colliders.size() && colliders[h].live)
+		read_shape(colliders[h]);
+}
+
+void CollisionDB::step()
+{
+	purge_dead();
+
+	for (sweep_entry& e : sweep) {
+		const collider& c = colliders[e.handle];
+		e.active = participates(c);
+		if (e.active) bounds_of(c, e.min, e.max);
+	}
+
+	//insertion sort; inactive entries keep their last bounds so the order stays valid
+	for (size_t i = 1; i < sweep.size(); ++i) {
+		sweep_entry e = sweep[i];
+		size_t j = i;
+		while (j > 0 && sweep[j - 1].min.x > e.min.x) {
+			sweep[j] = sweep[j - 1];
+			--j;
+		}
+		sweep[j] = e;
+	}
+
+	//sweep along x, prune on y, then test the actual shapes
+	new_contacts.clear();
+	candidate_pairs = 0;
+	for (size_t i = 0; i < sweep.size(); ++i) {
+		const sweep_entry& a = sweep[i];
+		if (!a.active) continue;
+
+		for (size_t j = i + 1; j < sweep.size() && sweep[j].min.x <= a.max.x; ++j) {
+			const sweep_entry& b = sweep[j];
+			if (!b.active || b.min.y > a.max.y || b.max.y < a.min.y) continue;
+
+			const collider& ca = colliders[a.handle];
+			const collider& cb = colliders[b.handle];
+			if (ca.actor == cb.actor) continue;
+
+			++candidate_pairs;
+			if (overlaps(ca, cb))
+				new_contacts.push_back(pair_key(a.handle, b.handle));
+		}
+	}
+	std::sort(new_contacts.begin(), new_contacts.end());
+
+	//diff against last step's contacts
+	size_t i = 0;
+	size_t j = 0;
+	while (i < contacts.size() || j < new_contacts.size()) {
+		if (j == new_contacts.size() || (i < contacts.size() && contacts[i] < new_contacts[j])) {
+			queue_event(COLLISION_EXIT, contacts[i++]);
+		}
+		else if (i == contacts.size() || new_contacts[j] < contacts[i]) {
+			queue_event(COLLISION_ENTER, new_contacts[j++]);
+		}
+		else {
+			queue_event(COLLISION_STAY, contacts[i]);
+			++i;
+			++j;
+		}
+	}
+	contacts.swap(new_contacts);
+
+	deliver_events();
+}
+
+void CollisionDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("colliders", static_cast<double>(colliders.size() - free_handles.size() - dead_handles.size()));
+	out.emplace_back("collision_candidates", static_cast<double>(candidate_pairs));
+	out.emplace_back("collision_contacts", static_cast<double>(contacts.size()));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+void CollisionDB::read_shape(collider& c)
+{
+	auto read_float = [&c](const char* field, float fallback) {
+		LuaRef v = c.comp[field];
+		return v.isNumber() ? v.cast<float>() : fallback;
+	};
+
+	c.offset = glm::vec2(read_float("offset_x", 0.f), read_float("offset_y", 0.f));
+	c.half_extents = glm::vec2(read_float("width", 1.f), read_float("height", 1.f)) * 0.5f;
+	c.radius = read_float("radius", 0.5f);
+
+	LuaRef trigger = c.comp["is_trigger"];
+	c.is_trigger = trigger.isBool() && trigger.cast<bool>();
+}
+
+bool CollisionDB::participates(const collider& c)
+{
+	if (!c.live || !c.actor->is_active() || !c.actor->has_started() || c.actor->activation.asleep)
+		return false;
+
+	LuaRef enabled = c.comp["enabled"];
+	return enabled.cast<bool>();
+}
+
+void CollisionDB::bounds_of(const collider& c, glm::vec2& min, glm::vec2& max)
+{
+	//shapes stay axis aligned, so only the world position and scale matter
+	const ComponentStore::transform_columns& t = ComponentStore::get_transforms();
+	uint32_t row = ComponentStore::transform_row(c.actor->store_slot);
+	glm::vec2 scale = glm::vec2(t.scale_x[row], t.scale_y[row]);
+	glm::vec2 center = glm::vec2(t.x[row], t.y[row]) + c.offset * scale;
+	scale = glm::abs(scale);
+
+	glm::vec2 half = c.shape == SHAPE_CIRCLE ? glm::vec2(c.radius * std::max(scale.x, scale.y)) : c.half_extents * scale;
+	min = center - half;
+	max = center + half;
+}
+
+bool CollisionDB::overlaps(const collider& a, const collider& b)
+{
+	//bounds already overlap, which is exact for two boxes
+	if (a.shape == SHAPE_BOX && b.shape == SHAPE_BOX) return true;
+
+	glm::vec2 a_min, a_max, b_min, b_max;
+	bounds_of(a, a_min, a_max);
+	bounds_of(b, b_min, b_max);
+
+	glm::vec2 a_center = (a_min + a_max) * 0.5f;
+	glm::vec2 b_center = (b_min + b_max) * 0.5f;
+
+	if (a.shape == SHAPE_CIRCLE && b.shape == SHAPE_CIRCLE) {
+		float r = (a_max.x - a_min.x + b_max.x - b_min.x) * 0.5f;
+		glm::vec2 d = a_center - b_center;
+		return glm::dot(d, d) <= r * r;
+	}
+
+	//circle against box: closest point on the box to the circle's center
+	const glm::vec2& circle_center = a.shape == SHAPE_CIRCLE ? a_center : b_center;
+	float r = a.shape == SHAPE_CIRCLE ? (a_max.x - a_min.x) * 0.5f : (b_max.x - b_min.x) * 0.5f;
+	glm::vec2 box_min = a.shape == SHAPE_CIRCLE ? b_min : a_min;
+	glm::vec2 box_max = a.shape == SHAPE_CIRCLE ? b_max : a_max;
+
+	glm::vec2 d = circle_center - glm::clamp(circle_center, box_min, box_max);
+	return glm::dot(d, d) <= r * r;
+}
+
+void CollisionDB::purge_dead()
+{
+	if (dead_handles.empty()) return;
+
+	//exit callbacks may remove more colliders; those wait for the next purge
+	std::vector<uint32_t> dead;
+	dead.swap(dead_handles);
+	std::sort(dead.begin(), dead.end());
+	auto is_dead = [&dead](uint32_t h) { return std::binary_search(dead.begin(), dead.end(), h); };
+
+	//(event, surviving handle, removed side's actor); contacts between two removed colliders just end
+	std::vector<std::tuple<uint8_t, uint32_t, Actor*>> exits;
+	for (uint64_t key : contacts) {
+		uint32_t h_a = static_cast<uint32_t>(key >> 32);
+		uint32_t h_b = static_cast<uint32_t>(key);
+		bool dead_a = is_dead(h_a);
+		bool dead_b = is_dead(h_b);
+		if (dead_a == dead_b) continue;
+
+		uint8_t collision_event = colliders[h_a].is_trigger || colliders[h_b].is_trigger ? TRIGGER_EXIT : COLLISION_EXIT;
+		if (dead_a) exits.emplace_back(collision_event, h_b, colliders[h_a].actor);
+		else exits.emplace_back(collision_event, h_a, colliders[h_b].actor);
+	}
+
+	contacts.erase(std::remove_if(contacts.begin(), contacts.end(),
+		[&is_dead](uint64_t key) { return is_dead(static_cast<uint32_t>(key >> 32)) || is_dead(static_cast<uint32_t>(key)); }), contacts.end());
+	sweep.erase(std::remove_if(sweep.begin(), sweep.end(),
+		[&is_dead](const sweep_entry& e) { return is_dead(e.handle); }), sweep.end());
+
+	//the removed sides' actors and tables are still valid here; the survivor may itself go during an earlier callback
+	for (const auto& [collision_event, handle, other] : exits) {
+		Actor* a = colliders[handle].actor;
+		if (colliders[handle].live && a->is_active()) a->on_collision(collision_event, other);
+	}
+
+	for (uint32_t h : dead) {
+		colliders[h].actor = nullptr;
+		colliders[h].comp = LuaRef(colliders[h].comp.state());
+		free_handles.push_back(h);
+	}
+}
+
+void CollisionDB::queue_event(uint8_t collision_event, uint64_t key)
+{
+	const collider& a = colliders[static_cast<uint32_t>(key >> 32)];
+	const collider& b = colliders[static_cast<uint32_t>(key)];
+
+	//either side being a trigger makes the whole contact a trigger contact
+	if (a.is_trigger || b.is_trigger)
+		collision_event += TRIGGER_ENTER;
+
+	//stable contacts cost nothing unless someone wants the stay callback
+	if ((collision_event == COLLISION_STAY || collision_event == TRIGGER_STAY) &&
+		!a.actor->listens_for(collision_event) && !b.actor->listens_for(collision_event))
+		return;
+
+	events.emplace_back(collision_event, key);
+}
+
+void CollisionDB::deliver_events()
+{
+	//callbacks can add colliders (so no references across calls) or remove them (so re-check live)
+	for (size_t i = 0; i < events.size(); ++i) {
+		uint8_t collision_event = events[i].first;
+		uint32_t h_a = static_cast<uint32_t>(events[i].second >> 32);
+		uint32_t h_b = static_cast<uint32_t>(events[i].second);
+
+		if (!colliders[h_a].live || !colliders[h_b].live) continue;
+
+		Actor* a = colliders[h_a].actor;
+		Actor* b = colliders[h_b].actor;
+
+		if (a->is_active()) a->on_collision(collision_event, b);
+		if (b->is_active() && colliders[h_a].live && colliders[h_b].live) b->on_collision(collision_event, a);
+	}
+	events.clear();
+}
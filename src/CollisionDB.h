@@ -0,0 +1,106 @@
+#ifndef COLLISION_DB_H
+#define COLLISION_DB_H
+
+#include "glm/glm.hpp"
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//native BoxCollider / CircleCollider components: sweep and prune broadphase, cached contact pairs,
+//and OnCollision* / OnTrigger* callbacks delivered after update
+class CollisionDB
+{
+public:
+	//indices into EVENT_FUNCTIONS, also the bits of Actor's collision listener mask
+	static inline const uint8_t COLLISION_ENTER = 0;
+	static inline const uint8_t COLLISION_STAY = 1;
+	static inline const uint8_t COLLISION_EXIT = 2;
+	static inline const uint8_t TRIGGER_ENTER = 3;
+	static inline const uint8_t TRIGGER_STAY = 4;
+	static inline const uint8_t TRIGGER_EXIT = 5;
+	static inline const uint8_t EVENT_COUNT = 6;
+	static inline const char* const EVENT_FUNCTIONS[EVENT_COUNT] = {
+		"OnCollisionEnter", "OnCollisionStay", "OnCollisionExit",
+		"OnTriggerEnter", "OnTriggerStay", "OnTriggerExit"
+	};
+
+	//registers the collider component types (and the Physics namespace) with ComponentDB
+	static void add_component_types(lua_State* state);
+
+	//starts simulating comp (a collider component on a, which must stay alive until remove_collider); returns its handle
+	static uint32_t add_collider(Actor* a, luabridge::LuaRef& comp);
+	//stops simulating the collider; its contacts end at the next purge_dead
+	static void remove_collider(uint32_t handle);
+
+	//ends the contacts of removed colliders: the other side gets OnCollisionExit / OnTriggerExit with the removed
+	//collider's actor, so call while that actor is still alive (SceneDB::release_destroyed, and the start of step)
+	static void purge_dead();
+
+	//re-reads size, offset and is_trigger from the component table (lua: collider:Refresh())
+	static void refresh_collider(const luabridge::LuaRef& comp);
+
+	//finds this frame's contacts and delivers enter / stay / exit callbacks
+	static void step();
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	static inline const uint8_t SHAPE_BOX = 0;
+	static inline const uint8_t SHAPE_CIRCLE = 1;
+
+	struct collider {
+		collider(Actor* a, const luabridge::LuaRef& comp) : actor(a), comp(comp) {}
+
+		Actor* actor;
+		luabridge::LuaRef comp;
+		uint8_t shape = SHAPE_BOX;
+		bool is_trigger = false;
+		bool live = true;
+		glm::vec2 offset = { 0.f, 0.f };
+		glm::vec2 half_extents = { 0.5f, 0.5f };
+		float radius = 0.5f;
+	};
+
+	//world bounds kept in a flat array sorted by min.x; the order persists across frames so re-sorting is near linear
+	struct sweep_entry {
+		glm::vec2 min;
+		glm::vec2 max;
+		uint32_t handle;
+		bool active;
+	};
+
+	static inline uint32_t box_type_id = UINT32_MAX;
+	static inline uint32_t circle_type_id = UINT32_MAX;
+
+	static inline std::vector<collider> colliders;		//by handle
+	static inline std::vector<uint32_t> free_handles;
+	static inline std::vector<uint32_t> dead_handles;		//removed since the last step, freed once their contacts are purged
+	static inline std::vector<sweep_entry> sweep;
+
+	static inline std::vector<uint64_t> contacts;			//pair keys overlapping last step, sorted
+	static inline std::vector<uint64_t> new_contacts;
+	static inline std::vector<std::pair<uint8_t, uint64_t>> events;	//(event, pair) waiting for delivery
+
+	static inline size_t candidate_pairs = 0;
+
+	static uint64_t pair_key(uint32_t a, uint32_t b) {
+		if (a > b) std::swap(a, b);
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	static void read_shape(collider& c);
+	static bool participates(const collider& c);
+	static void bounds_of(const collider& c, glm::vec2& min, glm::vec2& max);
+	static bool overlaps(const collider& a, const collider& b);
+
+	static void queue_event(uint8_t collision_event, uint64_t key);
+	static void deliver_events();
+};
+
+#endif
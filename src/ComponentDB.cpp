@@ -7,11 +7,31 @@
 #include "AudioDB.h"
 #include "Engine.h"
 #include "Transform.h"
+#include "CollisionDB.h"
+#include "ComponentStore.h"
+#include "NativeComponentDB.h"
+#include "AnimationDB.h"
+#include "ParticleDB.h"
+#include "TweenDB.h"
+#include "CoroutineDB.h"
+#include "TimerDB.h"
+#include "EventDB.h"
+#include "ShardDB.h"
+#include "LuaGC.h"
+#include "Profiler.h"
+#include "LuaBindings.h"
+#include "LuaHandles.h"
+#include "Interner.h"
+#include "EngineUtils.h"
 
 #include "Helper.h"
 #include "keycode_to_scancode.h"
 
 #include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <iterator>
 #include <thread>
 #include <cstdlib>
 #include <sstream>
@@ -30,31 +50,51 @@ void ComponentDB::init()
 		exit(0);
 	}
 
-	state = luaL_newstate();
+	//same as luaL_newstate, but lua's blocks come from the pooled allocator
+	state = lua_newstate(&LuaAllocator::alloc, &allocator);
+	if (state == nullptr) {
+		cout << "error: failed to create lua state";
+		exit(0);
+	}
+	lua_atpanic(state, &ComponentDB::panic);
 	luaL_openlibs(state);
 
 	/* add classes (such as Actor) to global state */
 	add_global_classes();
+	LuaHandles::init(state);
 
 	/* add namespaces and functions (such as Debug.Log) to global state */
 	add_global_functions();
 
-	/* read in all components */
-	if (!std::filesystem::exists(COMPONENT_FOLDER_PATH)) return;
-
-	for (const auto& entry : std::filesystem::directory_iterator(COMPONENT_FOLDER_PATH)) {
-
-		std::string compname = entry.path().filename().stem().string();
-
-		if (luaL_dofile(state, entry.path().string().c_str()) != LUA_OK) {
-			cout << "problem with lua file " << compname;
-			exit(0);
-		}
+	/* swap the hottest of those for raw lua_CFunctions */
+	LuaBindings::add_functions(state);
+
+	/* add native component types (such as BoxCollider); component files may not reuse their names */
+	CollisionDB::add_component_types(state);
+	ComponentStore::add_component_types(state);
+	AnimationDB::add_component_types(state);
+	ParticleDB::add_component_types(state);
+	TweenDB::add_functions(state);
+	CoroutineDB::add_functions(state);
+	TimerDB::add_functions(state);
+	EventDB::add_functions(state);
+	ShardDB::add_functions(state);
+	Profiler::add_functions(state);
+	NativeComponentDB::add_component_types(state);
+
+	/* find engine components (lua files next to the native plugins), then the game's; they run on first use */
+	find_component_files(ENGINE_COMPONENT_FOLDER_PATH);
+	find_component_files(COMPONENT_FOLDER_PATH);
+
+	lua_pushglobaltable(state);
+	lua_newtable(state);
+	lua_pushcfunction(state, &ComponentDB::lazy_global);
+	lua_setfield(state, -2, "__index");
+	lua_setmetatable(state, -2);
+	lua_pop(state, 1);
 
+	LuaGC::attach(state);
 
-		LuaRef new_comp_prototype = luabridge::getGlobal(state, compname.c_str());
-	}
-	
 	initialized = true;
 }
 
@@ -65,7 +105,9 @@ void ComponentDB::deinit()
 		exit(0);
 	}
 
+	LuaHandles::deinit();
 	lua_close(state);
+	allocator.release();
 
 	initialized = false;
 }
@@ -74,6 +116,8 @@ void ComponentDB::deinit()
 
 int ComponentDB::get_component(LuaRef& instance_table, std::string comp_name)
 {
+	load_component_type(comp_name);
+
 	LuaRef parent_table = luabridge::getGlobal(state, comp_name.c_str());
 	if (!parent_table.isTable()) {
 		cout << "error: failed to locate component " << comp_name;
@@ -172,7 +216,27 @@ int ComponentDB::inherit(LuaRef& instance_table, const LuaRef& parent_table)
 {
 	/* create metatable */
 	LuaRef new_metatable = luabridge::newTable(state);
-	new_metatable["__index"] = parent_table;
+
+	LuaRef native_type_id = parent_table["__native_type"];
+	if (native_type_id.isNumber()) {
+		//native fields resolve to C++ data once the component is attached, everything else falls through to parent_table
+		int fields_ref = native_field_tables.at(native_type_id.cast<uint32_t>());
+
+		parent_table.push(state);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, fields_ref);
+		lua_pushcclosure(state, &ComponentDB::proxy_index, 2);
+		new_metatable["__index"] = LuaRef::fromStack(state, -1);
+		lua_pop(state, 1);
+
+		parent_table.push(state);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, fields_ref);
+		lua_pushcclosure(state, &ComponentDB::proxy_newindex, 2);
+		new_metatable["__newindex"] = LuaRef::fromStack(state, -1);
+		lua_pop(state, 1);
+	}
+	else {
+		new_metatable["__index"] = parent_table;
+	}
 
 	/* use c api to set metatable */
 	instance_table.push(state);
@@ -183,8 +247,382 @@ int ComponentDB::inherit(LuaRef& instance_table, const LuaRef& parent_table)
 	return 0;
 }
 
+void ComponentDB::register_native_type(const std::string& name, luabridge::LuaRef& prototype, const native_type& type)
+{
+	uint32_t type_id = Interner::get_id(name);
+	if (is_native_type(type_id)) {
+		cout << "error: native component type " << name << " registered twice";
+		exit(0);
+	}
+
+	const native_type& stored = native_types.emplace(type_id, type).first->second;
+
+	if (!type.fields.empty()) {
+		prototype["__native_type"] = type_id;
+
+		//field name -> native_field, so the proxies resolve (or reject) a key with one hashed lookup
+		lua_State* L = prototype.state();
+		lua_createtable(L, 0, static_cast<int>(stored.fields.size()));
+		for (const auto& field : stored.fields) {
+			lua_pushlightuserdata(L, const_cast<native_field*>(&field.second));
+			lua_setfield(L, -2, field.first.c_str());
+		}
+		native_field_tables[type_id] = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	luabridge::setGlobal(prototype.state(), prototype, name.c_str());
+}
+
+uint32_t ComponentDB::attach_native(uint32_t type_id, Actor* a, luabridge::LuaRef& comp)
+{
+	const native_type& type = native_types.at(type_id);
+	uint32_t handle = type.attach(a, comp);
+
+	//drop instance values so reads and writes go through the proxy
+	comp.push(state);
+	for (const auto& field : type.fields) {
+		lua_pushstring(state, field.first.c_str());
+		lua_pushnil(state);
+		lua_rawset(state, -3);
+	}
+	lua_pop(state, 1);
+
+	return handle;
+}
+
+void ComponentDB::detach_native(uint32_t type_id, uint32_t handle)
+{
+	native_types.at(type_id).detach(handle);
+}
+
 /* ------------------------ private ------------------------ */
 
+namespace {
+	//prefixed to every cached chunk; lua's own dump header covers the vm version and number formats
+	struct script_cache_header {
+		char magic[4];
+		uint32_t lua_version;
+		uint64_t source_hash;
+		uint64_t source_size;
+	};
+
+	uint64_t fnv1a(const char* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	int dump_writer(lua_State*, const void* p, size_t size, void* ud)
+	{
+		std::string* out = static_cast<std::string*>(ud);
+		out->append(static_cast<const char*>(p), size);
+		return 0;
+	}
+}
+
+void ComponentDB::find_component_files(const std::string& folder)
+{
+	if (!std::filesystem::exists(folder)) return;
+
+	for (const auto& entry : std::filesystem::directory_iterator(folder)) {
+		if (entry.path().extension().string() != ".lua") continue;
+
+		std::string compname = entry.path().filename().stem().string();
+
+		if (is_native_type(Interner::find_id(compname))) {
+			cout << "error: component file " << compname << " uses the name of a native component";
+			exit(0);
+		}
+
+		unloaded_component_files[compname].push_back(entry.path().string());
+	}
+}
+
+void ComponentDB::load_component_type(const std::string& type)
+{
+	auto it = unloaded_component_files.find(type);
+	if (it == unloaded_component_files.end()) return;
+
+	//erased first: the file may name its own type (or others that name it) while it runs
+	std::vector<std::string> paths = std::move(it->second);
+	unloaded_component_files.erase(it);
+
+	uint64_t load_begin = SDL_GetPerformanceCounter();
+	for (const std::string& path : paths) {
+		bool loaded;
+		auto chunk = precompiled.find(path);
+		if (chunk != precompiled.end()) {
+			loaded = luaL_loadbufferx(state, chunk->second.data(), chunk->second.size(), ("@" + path).c_str(), "b") == LUA_OK;
+			precompiled.erase(chunk);
+		}
+		else {
+			loaded = load_script(state, path, script_cache_hits);
+		}
+
+		if (!loaded || lua_pcall(state, 0, 0, 0) != LUA_OK) {
+			cout << "problem with lua file " << type;
+			exit(0);
+		}
+		++script_files;
+	}
+	script_load_ms += (SDL_GetPerformanceCounter() - load_begin) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	if (ShardDB::is_enabled())
+		ShardDB::register_if_parallel(state, type, paths);
+}
+
+void ComponentDB::collect_scene_references(const rapidjson::Value& scene, std::unordered_set<std::string>& types, std::unordered_set<std::string>& strings)
+{
+	//actor properties are named after their component type; names that are not component files are skipped when loading
+	if (!scene.HasMember("layers") || !scene["layers"].IsArray()) return;
+
+	for (const auto& layer : scene["layers"].GetArray()) {
+		if (!layer.HasMember("objects") || !layer["objects"].IsArray()) continue;
+
+		for (const auto& actor : layer["objects"].GetArray()) {
+			if (!actor.HasMember("properties") || !actor["properties"].IsArray()) continue;
+
+			for (const auto& prop : actor["properties"].GetArray()) {
+				if (!prop.HasMember("name") || !prop["name"].IsString()) continue;
+
+				std::string name = prop["name"].GetString();
+				bool has_string = prop.HasMember("value") && prop["value"].IsString();
+				if (name == "template" && has_string) {
+					collect_template_references(prop["value"].GetString(), types, strings);
+					continue;
+				}
+
+				types.insert(name);
+				for (const auto& field : prop.GetObject()) {
+					if (field.value.IsString()) strings.insert(field.value.GetString());
+				}
+			}
+		}
+	}
+}
+
+void ComponentDB::precompile_component_types(const std::unordered_set<std::string>& types)
+{
+	std::vector<std::string> paths;
+	for (const std::string& type : types) {
+		auto it = unloaded_component_files.find(type);
+		if (it != unloaded_component_files.end())
+			paths.insert(paths.end(), it->second.begin(), it->second.end());
+	}
+	if (paths.empty()) return;
+
+	size_t thread_count = std::min<size_t>(paths.size(), std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::vector<std::pair<std::string, std::string>>> chunks(thread_count);
+	std::vector<size_t> cache_hits(thread_count, 0);
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&paths, &chunks, &cache_hits, thread_count, t]() {
+			//only the bytecode crosses over to the main state
+			lua_State* L = luaL_newstate();
+			for (size_t i = t; i < paths.size(); i += thread_count) {
+				//a file that does not compile is left for the main state, which reports it when the type loads
+				if (!load_script(L, paths[i], cache_hits[t])) {
+					lua_settop(L, 0);
+					continue;
+				}
+
+				std::string chunk;
+				lua_dump(L, &dump_writer, &chunk, 0);
+				lua_pop(L, 1);
+				chunks[t].emplace_back(paths[i], std::move(chunk));
+			}
+			lua_close(L);
+		});
+	}
+
+	for (size_t t = 0; t < thread_count; ++t) {
+		threads[t].join();
+		for (auto& chunk : chunks[t]) {
+			precompiled.emplace(std::move(chunk.first), std::move(chunk.second));
+		}
+		script_cache_hits += cache_hits[t];
+	}
+}
+
+void ComponentDB::load_component_types(const std::unordered_set<std::string>& types)
+{
+	check_init();
+
+#ifdef DEBUG
+	size_t known = script_files + unloaded_component_files.size();
+#endif
+	for (const std::string& type : types) {
+		load_component_type(type);
+	}
+
+#ifdef DEBUG
+	cout << "component files: " << script_files << " of " << known << " loaded for the scene in " << script_load_ms << " ms ("
+		<< script_cache_hits << " from cache" << (script_cache_enabled ? "" : ", cache disabled") << ")" << endl;
+#endif
+}
+
+bool ComponentDB::load_script(lua_State* L, const std::string& path, size_t& cache_hits)
+{
+	std::ifstream source_file(path, std::ios::binary);
+	if (!source_file) return false;
+	std::string source((std::istreambuf_iterator<char>(source_file)), std::istreambuf_iterator<char>());
+
+	//same chunk name as luaL_loadfile, so error messages and debug info read the same either way
+	std::string chunkname = "@" + path;
+
+	script_cache_header header = { { 'G', 'L', 'B', 'C' }, LUA_VERSION_NUM, fnv1a(source.data(), source.size()), source.size() };
+	std::string cache_path = cache_path_of(path);
+
+	if (script_cache_enabled) {
+		std::ifstream cache_file(cache_path, std::ios::binary);
+		script_cache_header cached;
+		if (cache_file && cache_file.read(reinterpret_cast<char*>(&cached), sizeof(cached)) &&
+			std::memcmp(&cached, &header, sizeof(header)) == 0) {
+			std::string chunk((std::istreambuf_iterator<char>(cache_file)), std::istreambuf_iterator<char>());
+			if (luaL_loadbufferx(L, chunk.data(), chunk.size(), chunkname.c_str(), "b") == LUA_OK) {
+				++cache_hits;
+				return true;
+			}
+			//written by a different build of lua: recompile and overwrite
+			lua_pop(L, 1);
+		}
+	}
+
+	if (luaL_loadbufferx(L, source.data(), source.size(), chunkname.c_str(), "t") != LUA_OK) return false;
+
+	if (script_cache_enabled) {
+		//debug info is kept so line numbers in runtime errors survive; a failed write just means compiling next launch too
+		std::string chunk;
+		lua_dump(L, &dump_writer, &chunk, 0);
+
+		std::error_code ec;
+		std::filesystem::create_directories(SCRIPT_CACHE_FOLDER_PATH, ec);
+		std::ofstream cache_file(cache_path, std::ios::binary | std::ios::trunc);
+		if (cache_file) {
+			cache_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			cache_file.write(chunk.data(), chunk.size());
+		}
+	}
+	return true;
+}
+
+std::string ComponentDB::cache_path_of(const std::string& path)
+{
+	//engine and game folders may both have a file with the same name
+	char folder_hash[17];
+	std::string folder = std::filesystem::path(path).parent_path().string();
+	snprintf(folder_hash, sizeof(folder_hash), "%016llx", static_cast<unsigned long long>(fnv1a(folder.data(), folder.size())));
+
+	return SCRIPT_CACHE_FOLDER_PATH + std::filesystem::path(path).stem().string() + "_" + folder_hash + ".luac";
+}
+
+int ComponentDB::lazy_global(lua_State* L)
+{
+	//(global table, key); only reached for globals that are not set
+	if (lua_type(L, 2) == LUA_TSTRING) {
+		auto it = unloaded_component_files.find(lua_tostring(L, 2));
+		if (it != unloaded_component_files.end()) {
+			load_component_type(it->first);
+			lua_settop(L, 2);
+			lua_rawget(L, 1);
+			return 1;
+		}
+	}
+	lua_pushnil(L);
+	return 1;
+}
+
+void ComponentDB::collect_template_references(const std::string& template_name, std::unordered_set<std::string>& types, std::unordered_set<std::string>& strings)
+{
+	std::string path = TEMPLATES_FOLDER_PATH + template_name + ".template";
+	if (!std::filesystem::exists(path)) return;
+
+	rapidjson::Document d;
+	EngineUtils::ReadJsonFile(path, d);
+
+	if (d.HasMember("template") && d["template"].IsString())
+		collect_template_references(d["template"].GetString(), types, strings);
+
+	if (d.HasMember("components") && d["components"].IsObject()) {
+		for (const auto& component : d["components"].GetObject()) {
+			if (!component.value.IsObject()) continue;
+
+			if (component.value.HasMember("type") && component.value["type"].IsString())
+				types.insert(component.value["type"].GetString());
+			for (const auto& field : component.value.GetObject()) {
+				if (field.value.IsString()) strings.insert(field.value.GetString());
+			}
+		}
+	}
+}
+
+void ComponentDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("script_files", static_cast<double>(script_files));
+	out.emplace_back("script_files_unloaded", static_cast<double>(unloaded_component_files.size()));
+	out.emplace_back("script_cache_hits", static_cast<double>(script_cache_hits));
+	out.emplace_back("script_load_ms", script_load_ms);
+	allocator.collect_stats(out);
+	LuaGC::collect_stats(out);
+}
+
+const ComponentDB::native_field* ComponentDB::find_native_field(lua_State* L, int key_idx)
+{
+	//keys that are not native fields (OnUpdate, enabled, actor, ...) miss here and fall through to the parent
+	if (lua_type(L, key_idx) != LUA_TSTRING) return nullptr;
+
+	lua_pushvalue(L, key_idx);
+	lua_rawget(L, lua_upvalueindex(2));
+	const native_field* field = static_cast<const native_field*>(lua_touserdata(L, -1));
+	lua_pop(L, 1);
+	return field;
+}
+
+int ComponentDB::proxy_index(lua_State* L)
+{
+	//(table, key), upvalues (parent, field table)
+	const native_field* field = find_native_field(L, 2);
+	if (field != nullptr) {
+		lua_pushstring(L, "native_id");
+		lua_rawget(L, 1);
+		if (lua_isinteger(L, -1)) {
+			uint32_t handle = static_cast<uint32_t>(lua_tointeger(L, -1));
+			lua_pop(L, 1);
+			field->get(L, handle);
+			return 1;
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_pushvalue(L, 2);
+	lua_gettable(L, lua_upvalueindex(1));
+	return 1;
+}
+
+int ComponentDB::proxy_newindex(lua_State* L)
+{
+	//(table, key, value), upvalues (parent, field table)
+	const native_field* field = find_native_field(L, 2);
+	if (field != nullptr) {
+		lua_pushstring(L, "native_id");
+		lua_rawget(L, 1);
+		if (lua_isinteger(L, -1)) {
+			uint32_t handle = static_cast<uint32_t>(lua_tointeger(L, -1));
+			lua_pop(L, 1);
+			field->set(L, handle, 3);
+			return 0;
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_rawset(L, 1);
+	return 0;
+}
+
 
 
 void ComponentDB::add_global_classes()
@@ -214,6 +652,9 @@ void ComponentDB::add_global_classes()
 		.addFunction("GetComponents", &Actor::get_components)
 		.addFunction("AddComponent", &Actor::cpp_add_component)
 		.addFunction("RemoveComponent", &Actor::cpp_remove_component)
+		.addFunction("StartImmediately", &Actor::start_immediately)
+		.addFunction("SetSleepWhenOffscreen", &Actor::set_sleep_offscreen)
+		.addFunction("GetTransform", &Actor::get_transform)
 		.endClass();
 
 	//Transform
@@ -226,6 +667,14 @@ void ComponentDB::add_global_classes()
 		.addData("scale", &Transform::scale)
 		.addData("rotation", &Transform::rotation_deg)
 		.addData("pivot", &Transform::pivot)
+		.addFunction("SetParent", &Transform::lua_set_parent)
+		.addFunction("GetParent", &Transform::get_parent)
+		.addFunction("GetChildCount", &Transform::get_child_count)
+		.addFunction("GetWorldPosition", &Transform::get_world_position)
+		.addFunction("GetWorldScale", &Transform::get_world_scale)
+		.addFunction("GetWorldRotation", &Transform::get_world_rotation)
+		.addFunction("SetWorldPosition", &Transform::set_world_position)
+		.addFunction("TransformPoint", &Transform::transform_point)
 		.endClass();
 }
  
@@ -245,6 +694,7 @@ void ComponentDB::add_global_functions()
 		.addFunction("Find", &Actor::get_actor)
 		.addFunction("FindAll", &Actor::get_actors)
 		.addFunction("Instantiate", &SceneDB::cpp_instantiate)
+		.addFunction("InstantiateMany", &SceneDB::cpp_instantiate_many)
 		.addFunction("Destroy", &SceneDB::cpp_destroy)
 		.endNamespace();
 
@@ -253,6 +703,12 @@ void ComponentDB::add_global_functions()
 		.beginNamespace("Debug")
 		.addFunction("Log", &LuaFuncs::cpp_log)
 		.addFunction("LogError", &LuaFuncs::cpp_log_err)
+		.addCFunction("GetGCStats", &LuaGC::lua_get_stats)
+#ifdef DEBUG
+		.addFunction("BenchmarkSpatial", &SceneDB::benchmark_spatial)
+		.addFunction("BenchmarkLuaAlloc", &LuaAllocator::benchmark)
+		.addCFunction("BenchmarkBindings", &LuaBindings::lua_benchmark)
+#endif
 		.endNamespace();
 
 	//Application
@@ -312,6 +768,11 @@ void ComponentDB::add_global_functions()
 		.addFunction("Load", &Engine::load_scene_cpp)
 		.addFunction("GetCurrent", &Engine::get_scene_name)
 		.addFunction("DontDestroy", &SceneDB::keep_actor)
+		.addFunction("GetStats", &SceneDB::get_stats)
+		.addFunction("DumpStats", &SceneDB::dump_stats)
+		.addFunction("QueryRect", &SceneDB::query_rect)
+		.addFunction("QueryRadius", &SceneDB::query_radius)
+		.addFunction("Nearest", &SceneDB::query_nearest)
 		.endNamespace();
 }
 
@@ -323,6 +784,13 @@ void ComponentDB::check_init()
 	}
 }
 
+int ComponentDB::panic(lua_State* L)
+{
+	const char* msg = lua_tostring(L, -1);
+	cout << "error: unprotected lua error: " << (msg != nullptr ? msg : "(error object is not a string)");
+	exit(0);
+}
+
 void LuaFuncs::cpp_sleep(int ms)
 {
 	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
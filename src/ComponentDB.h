@@ -8,8 +8,16 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 
+#include "LuaAllocator.h"
+
+class Actor;
+
 class ComponentDB
 {
 public:
@@ -26,18 +34,90 @@ public:
 
 	static int inherit(luabridge::LuaRef& instance_table, const luabridge::LuaRef& parent_table);
 
+	/* native component types: data and behaviour live in C++, the component table is what scripts hold */
+	struct native_field {
+		std::function<void(lua_State* L, uint32_t handle)> get;				//pushes the value
+		std::function<void(lua_State* L, uint32_t handle, int idx)> set;	//stores the value at stack idx
+	};
+	struct native_type {
+		std::function<uint32_t(Actor* a, luabridge::LuaRef& comp)> attach;	//component entered the scene; returns its handle
+		std::function<void(uint32_t handle)> detach;
+		std::vector<std::pair<std::string, native_field>> fields;			//proxied to native data while attached
+	};
+
+	//installs prototype as the global for name (its fields are the defaults json and lua override); call before component files load
+	static void register_native_type(const std::string& name, luabridge::LuaRef& prototype, const native_type& type);
+	static bool is_native_type(uint32_t type_id) { return native_types.find(type_id) != native_types.end(); }
+
+	//attach reads the component's fields, after which fields listed in native_type::fields go through the proxy
+	static uint32_t attach_native(uint32_t type_id, Actor* a, luabridge::LuaRef& comp);
+	static void detach_native(uint32_t type_id, uint32_t handle);
+
 	static lua_State* get_state() { return state; }
+	static const LuaAllocator& get_allocator() { return allocator; }
+
+	//load component files from precompiled chunks in SCRIPT_CACHE_FOLDER_PATH (on by default); call before init
+	static void set_script_cache(bool enabled) { script_cache_enabled = enabled; }
+
+	//component types (actor property names) and string values named by the scene and the templates it uses;
+	//only reads files, so it can run before init and off the main thread
+	static void collect_scene_references(const rapidjson::Value& scene, std::unordered_set<std::string>& types, std::unordered_set<std::string>& strings);
+
+	//compiles the files for types in throwaway lua states on several threads (after init, off the main thread);
+	//load_component_types then only has to load the bytecode
+	static void precompile_component_types(const std::unordered_set<std::string>& types);
+
+	//runs the component files for types now, so they load before the first frame instead of on first use
+	static void load_component_types(const std::unordered_set<std::string>& types);
+
+	//leaves the compiled chunk for path on L's stack (any state), from the cache when its source hash still matches
+	static bool load_script(lua_State* L, const std::string& path, size_t& cache_hits);
+
+	//allocator, collector and component file loading numbers
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
 
 	static bool is_init() { return initialized; }
 
 private:
 	inline static lua_State* state;
+	inline static LuaAllocator allocator;
+
+	inline static bool script_cache_enabled = true;
+	inline static size_t script_files = 0;			//loaded so far
+	inline static size_t script_cache_hits = 0;
+	inline static double script_load_ms = 0.0;		//reading, compiling or undumping, and running component files
+
+	//type name -> files not run yet (engine folder first, then the game's)
+	inline static std::unordered_map<std::string, std::vector<std::string>> unloaded_component_files;
+	inline static std::unordered_map<std::string, std::string> precompiled;		//path -> bytecode from precompile_component_types
 	inline static bool initialized = false;
 
+	inline static std::unordered_map<uint32_t, native_type> native_types;
+	inline static std::unordered_map<uint32_t, int> native_field_tables;		//type id -> registry ref of {field name = native_field*}
+
+	//__index / __newindex for native types with fields; both have the parent table and the type's field table as upvalues
+	static int proxy_index(lua_State* L);
+	static int proxy_newindex(lua_State* L);
+	static const native_field* find_native_field(lua_State* L, int key_idx);
+
+	//records every .lua file in folder; each defines the global table for its component type, and is run the first
+	//time that type is needed (get_component, a script reading the global, or load_component_types)
+	static void find_component_files(const std::string& folder);
+	static void load_component_type(const std::string& type);
+
+	//__index on the global table: loads a component file when a script names a type that has not been loaded
+	static int lazy_global(lua_State* L);
+	static void collect_template_references(const std::string& template_name, std::unordered_set<std::string>& types, std::unordered_set<std::string>& strings);
+
+	static std::string cache_path_of(const std::string& path);
+
 	static void add_global_classes();
 	static void add_global_functions();
 
 	static void check_init();
+
+	//error raised outside any pcall
+	static int panic(lua_State* L);
 };
 
 class LuaFuncs {
@@ -0,0 +1,263 @@
+#include "ComponentStore.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "Interner.h"
+#include "Renderer.h"
+#include "ImageDB.h"
+#include "SceneDB.h"
+
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+uint32_t ComponentStore::add_actor(Actor* a)
+{
+	uint32_t slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else {
+		slot = next_slot++;
+	}
+
+	transform_index.add(slot);
+	transforms.actor.push_back(a);
+
+	glm::vec2 pos = a->get_transform().get_world_position();
+	glm::vec2 scale = a->get_transform().get_world_scale();
+	transforms.x.push_back(pos.x);
+	transforms.y.push_back(pos.y);
+	transforms.rotation.push_back(a->get_transform().get_world_rotation());
+	transforms.scale_x.push_back(scale.x);
+	transforms.scale_y.push_back(scale.y);
+	transforms.pivot_x.push_back(a->get_transform().pivot.x);
+	transforms.pivot_y.push_back(a->get_transform().pivot.y);
+
+	return slot;
+}
+
+void ComponentStore::remove_actor(uint32_t slot)
+{
+	uint32_t row = transform_index.remove(slot);
+	swap_remove(transforms.actor, row);
+	swap_remove(transforms.x, row);
+	swap_remove(transforms.y, row);
+	swap_remove(transforms.rotation, row);
+	swap_remove(transforms.scale_x, row);
+	swap_remove(transforms.scale_y, row);
+	swap_remove(transforms.pivot_x, row);
+	swap_remove(transforms.pivot_y, row);
+
+	free_slots.push_back(slot);
+}
+
+void ComponentStore::sync_transforms()
+{
+	for (size_t row = 0; row < transforms.actor.size(); ++row) {
+		const Transform& t = transforms.actor[row]->get_transform();
+		glm::vec2 pos = t.get_world_position();
+		glm::vec2 scale = t.get_world_scale();
+
+		//catches writes that bypass Transform's setters (lua fields, tweens, native components, moving parents)
+		if (pos.x != transforms.x[row] || pos.y != transforms.y[row])
+			SceneDB::mark_moved(transforms.actor[row]);
+
+		transforms.x[row] = pos.x;
+		transforms.y[row] = pos.y;
+		transforms.rotation[row] = t.get_world_rotation();
+		transforms.scale_x[row] = scale.x;
+		transforms.scale_y[row] = scale.y;
+		transforms.pivot_x[row] = t.pivot.x;
+		transforms.pivot_y[row] = t.pivot.y;
+	}
+}
+
+void ComponentStore::submit_sprites()
+{
+	sprites_submitted = 0;
+	if (sprites.image.empty()) return;
+
+	const glm::vec2& ppu = Renderer::get_ppu();
+	float px_to_world = 1.f / std::min(ppu.x, ppu.y);
+	uint32_t no_image = Interner::get_id("");
+
+	for (size_t i = 0; i < sprites.image.size(); ++i) {
+		if (!sprites.enabled[i] || sprites.image[i] == no_image) continue;
+
+		uint32_t row = transform_index.row_of(sprites.actor_slot[i]);
+		const Actor* a = transforms.actor[row];
+		if (!a->is_active() || a->activation.asleep) continue;
+
+		const image_info& img = get_image_info(sprites.image[i]);
+		const SDL_Rect& src = sprites.src[i];
+		float sx = transforms.scale_x[row];
+		float sy = transforms.scale_y[row];
+
+		//any pivot and rotation stays inside a circle as wide as the image's width plus height
+		float size = src.w > 0 ? static_cast<float>(src.w + src.h) : img.w + img.h;
+		float radius = size * std::max(std::abs(sx), std::abs(sy)) * px_to_world;
+		glm::vec2 pos(transforms.x[row], transforms.y[row]);
+		if (!Renderer::is_visible(pos, radius)) continue;
+
+		Renderer::queue_sprite(img.tex, pos.x, pos.y, transforms.rotation[row],
+			sprites.flip_x[i] ? -sx : sx, sprites.flip_y[i] ? -sy : sy,
+			transforms.pivot_x[row], transforms.pivot_y[row],
+			sprites.r[i], sprites.g[i], sprites.b[i], sprites.a[i], sprites.sorting_order[i],
+			src.w > 0 ? &src : nullptr);
+		++sprites_submitted;
+	}
+}
+
+void ComponentStore::add_component_types(lua_State* state)
+{
+	ComponentDB::native_type sprite_type;
+	sprite_type.attach = &ComponentStore::attach_sprite;
+	sprite_type.detach = &ComponentStore::detach_sprite;
+
+	//accessors look the row up on every call since rows move when other sprites detach
+	sprite_type.fields = {
+		{ "sprite", {
+			[](lua_State* L, uint32_t h) { lua_pushstring(L, Interner::get_string(sprites.image[sprite_row(h)]).c_str()); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.image[sprite_row(h)] = Interner::get_id(luaL_checkstring(L, idx)); } } },
+		{ "r", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, sprites.r[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.r[sprite_row(h)] = to_channel(L, idx); } } },
+		{ "g", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, sprites.g[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.g[sprite_row(h)] = to_channel(L, idx); } } },
+		{ "b", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, sprites.b[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.b[sprite_row(h)] = to_channel(L, idx); } } },
+		{ "a", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, sprites.a[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.a[sprite_row(h)] = to_channel(L, idx); } } },
+		{ "sorting_order", {
+			[](lua_State* L, uint32_t h) { lua_pushinteger(L, sprites.sorting_order[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.sorting_order[sprite_row(h)] = static_cast<int>(luaL_checknumber(L, idx)); } } },
+		{ "flip_x", {
+			[](lua_State* L, uint32_t h) { lua_pushboolean(L, sprites.flip_x[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.flip_x[sprite_row(h)] = lua_toboolean(L, idx) ? 1 : 0; } } },
+		{ "flip_y", {
+			[](lua_State* L, uint32_t h) { lua_pushboolean(L, sprites.flip_y[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.flip_y[sprite_row(h)] = lua_toboolean(L, idx) ? 1 : 0; } } },
+		{ "enabled", {
+			[](lua_State* L, uint32_t h) { lua_pushboolean(L, sprites.enabled[sprite_row(h)]); },
+			[](lua_State* L, uint32_t h, int idx) { sprites.enabled[sprite_row(h)] = lua_toboolean(L, idx) ? 1 : 0; } } },
+	};
+
+	LuaRef sprite = luabridge::newTable(state);
+	sprite["sprite"] = std::string();
+	sprite["r"] = 255;
+	sprite["g"] = 255;
+	sprite["b"] = 255;
+	sprite["a"] = 255;
+	sprite["sorting_order"] = 0;
+	sprite["flip_x"] = false;
+	sprite["flip_y"] = false;
+	sprite["enabled"] = true;
+	ComponentDB::register_native_type("SpriteRenderer", sprite, sprite_type);
+}
+
+void ComponentStore::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("store_actors", static_cast<double>(transform_index.size()));
+	out.emplace_back("sprite_renderers", static_cast<double>(sprite_index.size()));
+	out.emplace_back("sprites_submitted", static_cast<double>(sprites_submitted));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+uint32_t ComponentStore::attach_sprite(Actor* a, luabridge::LuaRef& comp)
+{
+	uint32_t handle;
+	if (!free_sprite_handles.empty()) {
+		handle = free_sprite_handles.back();
+		free_sprite_handles.pop_back();
+	}
+	else {
+		handle = next_sprite_handle++;
+	}
+
+	auto read_channel = [&comp](const char* field) {
+		LuaRef v = comp[field];
+		return static_cast<uint8_t>(v.isNumber() ? std::clamp(v.cast<float>(), 0.f, 255.f) : 255.f);
+	};
+	auto read_bool = [&comp](const char* field, bool fallback) {
+		LuaRef v = comp[field];
+		return static_cast<uint8_t>(v.isBool() ? v.cast<bool>() : fallback);
+	};
+
+	LuaRef image = comp["sprite"];
+	LuaRef order = comp["sorting_order"];
+
+	sprite_index.add(handle);
+	sprites.actor_slot.push_back(a->store_slot);
+	sprites.image.push_back(Interner::get_id(image.isString() ? image.tostring() : ""));
+	sprites.r.push_back(read_channel("r"));
+	sprites.g.push_back(read_channel("g"));
+	sprites.b.push_back(read_channel("b"));
+	sprites.a.push_back(read_channel("a"));
+	sprites.sorting_order.push_back(order.isNumber() ? order.cast<int>() : 0);
+	sprites.flip_x.push_back(read_bool("flip_x", false));
+	sprites.flip_y.push_back(read_bool("flip_y", false));
+	sprites.enabled.push_back(read_bool("enabled", true));
+	sprites.src.push_back({ 0, 0, 0, 0 });
+
+	if (a->store_slot >= sprite_of_actor.size()) sprite_of_actor.resize(a->store_slot + 1, DenseIndex::NONE);
+	if (sprite_of_actor[a->store_slot] == DenseIndex::NONE) sprite_of_actor[a->store_slot] = handle;
+
+	return handle;
+}
+
+const ComponentStore::image_info& ComponentStore::get_image_info(uint32_t image)
+{
+	if (image >= image_cache.size()) image_cache.resize(image + 1);
+
+	image_info& info = image_cache[image];
+	if (info.tex == nullptr) {
+		info.tex = ImageDB::get_image(Interner::get_string(image));
+		int w = 0, h = 0;
+		SDL_QueryTexture(info.tex, NULL, NULL, &w, &h);
+		info.w = static_cast<float>(w);
+		info.h = static_cast<float>(h);
+	}
+	return info;
+}
+
+void ComponentStore::detach_sprite(uint32_t handle)
+{
+	uint32_t row = sprite_index.row_of(handle);
+	uint32_t slot = sprites.actor_slot[row];
+	if (sprite_of_actor[slot] == handle) {
+		//fall back to another sprite on the same actor, if it has one
+		sprite_of_actor[slot] = DenseIndex::NONE;
+		for (size_t i = 0; i < sprites.actor_slot.size(); ++i) {
+			if (i != row && sprites.actor_slot[i] == slot) {
+				sprite_of_actor[slot] = sprite_index.key_of(static_cast<uint32_t>(i));
+				break;
+			}
+		}
+	}
+
+	sprite_index.remove(handle);
+	swap_remove(sprites.actor_slot, row);
+	swap_remove(sprites.image, row);
+	swap_remove(sprites.r, row);
+	swap_remove(sprites.g, row);
+	swap_remove(sprites.b, row);
+	swap_remove(sprites.a, row);
+	swap_remove(sprites.sorting_order, row);
+	swap_remove(sprites.flip_x, row);
+	swap_remove(sprites.flip_y, row);
+	swap_remove(sprites.enabled, row);
+	swap_remove(sprites.src, row);
+
+	free_sprite_handles.push_back(handle);
+}
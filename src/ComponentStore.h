@@ -0,0 +1,148 @@
+#ifndef COMPONENT_STORE_H
+#define COMPONENT_STORE_H
+
+#include "SDL2/SDL.h"
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//packs rows for sparse keys (actor slots, component handles) so columns can be iterated without holes
+class DenseIndex
+{
+public:
+	static inline const uint32_t NONE = UINT32_MAX;
+
+	//adds key as the last row and returns that row
+	uint32_t add(uint32_t key) {
+		if (key >= rows.size()) rows.resize(key + 1, NONE);
+		rows[key] = static_cast<uint32_t>(keys.size());
+		keys.push_back(key);
+		return rows[key];
+	}
+
+	//removes key by moving the last row into its place; returns the freed row so callers can swap_remove their columns
+	uint32_t remove(uint32_t key) {
+		uint32_t row = rows[key];
+		uint32_t last_key = keys.back();
+		keys[row] = last_key;
+		rows[last_key] = row;
+		keys.pop_back();
+		rows[key] = NONE;
+		return row;
+	}
+
+	uint32_t row_of(uint32_t key) const { return key < rows.size() ? rows[key] : NONE; }
+	uint32_t key_of(uint32_t row) const { return keys[row]; }
+	size_t size() const { return keys.size(); }
+
+private:
+	std::vector<uint32_t> rows;		//key -> row
+	std::vector<uint32_t> keys;		//row -> key
+};
+
+template<typename T>
+inline void swap_remove(std::vector<T>& column, uint32_t row)
+{
+	column[row] = column.back();
+	column.pop_back();
+}
+
+//structure-of-arrays data for native components, kept outside the lua tables so engine passes can walk it linearly
+class ComponentStore
+{
+public:
+	//per-actor rows exist while the actor is in the scene (see SceneDB::index_actor)
+	static uint32_t add_actor(Actor* a);
+	static void remove_actor(uint32_t slot);
+
+	//world transform of every actor in the scene, refreshed once a frame by sync_transforms
+	struct transform_columns {
+		std::vector<Actor*> actor;
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> rotation;
+		std::vector<float> scale_x;
+		std::vector<float> scale_y;
+		std::vector<float> pivot_x;
+		std::vector<float> pivot_y;
+	};
+
+	//copies each actor's world transform into its row (run after Transform::update_hierarchy)
+	static void sync_transforms();
+	static const transform_columns& get_transforms() { return transforms; }
+	static uint32_t transform_row(uint32_t slot) { return transform_index.row_of(slot); }
+
+	//SpriteRenderer: lua reads and writes these through the component table's proxy metatable
+	struct sprite_columns {
+		std::vector<uint32_t> actor_slot;
+		std::vector<uint32_t> image;		//interned image name
+		std::vector<uint8_t> r;
+		std::vector<uint8_t> g;
+		std::vector<uint8_t> b;
+		std::vector<uint8_t> a;
+		std::vector<int> sorting_order;
+		std::vector<uint8_t> flip_x;
+		std::vector<uint8_t> flip_y;
+		std::vector<uint8_t> enabled;
+		std::vector<SDL_Rect> src;		//part of the image to draw, w == 0 for all of it (set by Animator)
+	};
+	static const sprite_columns& get_sprites() { return sprites; }
+
+	//handle of the SpriteRenderer on the actor in slot (the first one attached), or DenseIndex::NONE
+	static uint32_t find_sprite(uint32_t actor_slot) {
+		return actor_slot < sprite_of_actor.size() ? sprite_of_actor[actor_slot] : DenseIndex::NONE;
+	}
+	//points the sprite at one frame of a sheet
+	static void set_sprite_frame(uint32_t handle, uint32_t image, const SDL_Rect& src) {
+		uint32_t row = sprite_row(handle);
+		sprites.image[row] = image;
+		sprites.src[row] = src;
+	}
+
+	//queues every enabled, on-screen SpriteRenderer on an active, awake actor (run once transforms are synced)
+	static void submit_sprites();
+
+	//registers the native component types whose data lives here
+	static void add_component_types(lua_State* state);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+	//texture and size per interned image name, filled on first use (also used by the raw Image.Draw bindings)
+	struct image_info {
+		SDL_Texture* tex = nullptr;
+		float w = 0.f;
+		float h = 0.f;
+	};
+	static const image_info& get_image_info(uint32_t image);
+
+private:
+	static inline std::vector<uint32_t> free_slots;
+	static inline uint32_t next_slot = 0;
+	static inline DenseIndex transform_index;
+	static inline transform_columns transforms;
+
+	static inline std::vector<uint32_t> free_sprite_handles;
+	static inline uint32_t next_sprite_handle = 0;
+	static inline DenseIndex sprite_index;
+	static inline sprite_columns sprites;
+	static inline std::vector<uint32_t> sprite_of_actor;		//actor slot -> sprite handle
+	static inline size_t sprites_submitted = 0;
+
+	static inline std::vector<image_info> image_cache;
+
+	static uint32_t attach_sprite(Actor* a, luabridge::LuaRef& comp);
+	static void detach_sprite(uint32_t handle);
+	static uint32_t sprite_row(uint32_t handle) { return sprite_index.row_of(handle); }
+	static uint8_t to_channel(lua_State* L, int idx) {
+		lua_Number v = luaL_checknumber(L, idx);
+		return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+	}
+};
+
+#endif
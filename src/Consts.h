@@ -16,6 +16,9 @@ inline const std::string FONTS_FOLDER_PATH = RESOURCES_PATH + "/fonts/";
 inline const std::string AUDIO_FOLDER_PATH = RESOURCES_PATH + "/audio/";
 inline const std::string COMPONENT_FOLDER_PATH = RESOURCES_PATH + "/component_types/";
 inline const std::string TILEMAP_FOLDER_PATH = RESOURCES_PATH + "/tilesets/";
+inline const std::string ANIMATIONS_FOLDER_PATH = RESOURCES_PATH + "/animations/";
+inline const std::string SCRIPT_CACHE_FOLDER_PATH = RESOURCES_PATH + "/script_cache/";
+inline const std::string PROFILE_FOLDER_PATH = RESOURCES_PATH + "/profiles/";
 
 inline const std::string ENGINE_RES_PATH = "resources_internal";
 inline const std::string ENGINE_COMPONENT_FOLDER_PATH = ENGINE_RES_PATH + "/component_types/";
@@ -29,6 +32,8 @@ inline const SDL_Color WHITE = { 255, 255, 255, 255 };
 inline const SDL_Color RED = { 255, 0, 0, 255 };
 inline const SDL_Color BLUE = { 0, 0, 255, 255 };
 
+inline const int TARGET_FPS = 60;	//matches the 16ms frame pacing in Helper::SDL_Delay
+
 inline const int X_DEFAULT_RES = 640;
 inline const int Y_DEFAULT_RES = 360;
 
@@ -0,0 +1,269 @@
+#include "CoroutineDB.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void CoroutineDB::add_functions(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Coroutine")
+		.addFunction("Start", &CoroutineDB::lua_start)
+		.addFunction("Stop", &CoroutineDB::lua_stop)
+		.addFunction("IsRunning", &CoroutineDB::lua_is_running)
+		.endNamespace();
+
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Wait")
+		.addFunction("Frames", &CoroutineDB::lua_wait_frames)
+		.addFunction("Seconds", &CoroutineDB::lua_wait_seconds)
+		.addFunction("Until", &CoroutineDB::lua_wait_until)
+		.endNamespace();
+}
+
+void CoroutineDB::update(int frame, float now)
+{
+	current_frame = frame;
+	current_time = now;
+	resumed_last_frame = 0;
+
+	//collect first so waits of zero frames / seconds go to the next frame instead of spinning here
+	due.clear();
+	while (!frame_queue.empty() && frame_queue.top().due <= frame) {
+		due.push_back(frame_queue.top().id);
+		frame_queue.pop();
+	}
+	while (!time_queue.empty() && time_queue.top().due <= now) {
+		due.push_back(time_queue.top().id);
+		time_queue.pop();
+	}
+
+	if (!polling.empty()) {
+		lua_State* L = ComponentDB::get_state();
+		std::vector<uint32_t> still_waiting;
+		for (uint32_t id : polling) {
+			auto it = routines.find(id);
+			if (it == routines.end()) continue;
+
+			lua_rawgeti(L, LUA_REGISTRYINDEX, it->second.predicate_ref);
+			if (lua_pcall(L, 0, 1, 0) != LUA_OK) {
+				report(lua_tostring(L, -1));
+				lua_pop(L, 1);
+				finish(id);
+				continue;
+			}
+
+			bool ready = lua_toboolean(L, -1) != 0;
+			lua_pop(L, 1);
+			if (ready) due.push_back(id);
+			else still_waiting.push_back(id);
+		}
+		polling.swap(still_waiting);
+	}
+
+	//stale entries (stopped coroutines) are skipped by resume
+	std::vector<uint32_t> resuming;
+	resuming.swap(due);
+	for (uint32_t id : resuming) {
+		resume(id, 0);
+	}
+}
+
+void CoroutineDB::release(Actor* a)
+{
+	auto it = by_owner.find(a);
+	if (it == by_owner.end()) return;
+
+	std::vector<uint32_t> ids;
+	ids.swap(it->second);
+	by_owner.erase(it);
+
+	for (uint32_t id : ids) {
+		if (id == running) stop_running = true;
+		else finish(id);
+	}
+}
+
+void CoroutineDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("coroutines", static_cast<double>(routines.size()));
+	out.emplace_back("coroutines_polling", static_cast<double>(polling.size()));
+	out.emplace_back("coroutines_resumed", static_cast<double>(resumed_last_frame));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+int CoroutineDB::lua_start(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	int nargs = lua_gettop(L) - 1;
+
+	routine r;
+	r.thread = lua_newthread(L);
+	r.thread_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	//ends with the actor whose callback started it, or with the actor of a component (usually self) passed first
+	r.owner = Actor::get_running();
+	if (nargs > 0 && lua_istable(L, 2)) {
+		LuaRef actor = LuaRef::fromStack(L, 2)["actor"];
+		if (actor.isUserdata()) r.owner = actor.cast<Actor*>();
+	}
+
+	for (int i = 1; i <= nargs + 1; ++i) {
+		lua_pushvalue(L, i);
+	}
+	lua_xmove(L, r.thread, nargs + 1);
+
+	uint32_t id = next_id++;
+	if (r.owner != nullptr) by_owner[r.owner].push_back(id);
+	routines.emplace(id, r);
+
+	resume(id, nargs);
+
+	lua_pushinteger(L, id);
+	return 1;
+}
+
+int CoroutineDB::lua_stop(lua_State* L)
+{
+	uint32_t id = static_cast<uint32_t>(luaL_checkinteger(L, 1));
+	if (id == running) stop_running = true;
+	else if (routines.count(id)) finish(id);
+	return 0;
+}
+
+int CoroutineDB::lua_is_running(lua_State* L)
+{
+	uint32_t id = static_cast<uint32_t>(luaL_checkinteger(L, 1));
+	lua_pushboolean(L, routines.count(id) != 0 && !(id == running && stop_running));
+	return 1;
+}
+
+int CoroutineDB::lua_wait_frames(lua_State* L)
+{
+	lua_Integer frames = luaL_optinteger(L, 1, 1);
+	lua_settop(L, 0);
+	lua_pushinteger(L, WAIT_FRAMES);
+	lua_pushinteger(L, frames);
+	return lua_yield(L, 2);
+}
+
+int CoroutineDB::lua_wait_seconds(lua_State* L)
+{
+	lua_Number seconds = luaL_checknumber(L, 1);
+	lua_settop(L, 0);
+	lua_pushinteger(L, WAIT_SECONDS);
+	lua_pushnumber(L, seconds);
+	return lua_yield(L, 2);
+}
+
+int CoroutineDB::lua_wait_until(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	lua_settop(L, 1);
+	lua_pushinteger(L, WAIT_UNTIL);
+	lua_insert(L, 1);
+	return lua_yield(L, 2);
+}
+
+void CoroutineDB::resume(uint32_t id, int nargs)
+{
+	auto it = routines.find(id);
+	if (it == routines.end()) return;
+
+	lua_State* thread = it->second.thread;
+
+	//a coroutine may start or resume another; remember who was running
+	uint32_t outer = running;
+	bool outer_stop = stop_running;
+	running = id;
+	stop_running = false;
+
+	int nresults = 0;
+	int status;
+	{
+		Actor::running_scope running_actor(it->second.owner);
+		status = lua_resume(thread, ComponentDB::get_state(), nargs, &nresults);
+	}
+	++resumed_last_frame;
+
+	bool stopped = stop_running;
+	running = outer;
+	stop_running = outer_stop;
+
+	it = routines.find(id);
+	if (it == routines.end()) return;
+
+	if (status == LUA_YIELD && !stopped) {
+		schedule(id, it->second, nresults);
+		return;
+	}
+
+	if (status != LUA_OK && status != LUA_YIELD) {
+		report(lua_tostring(thread, -1));
+	}
+	finish(id);
+}
+
+void CoroutineDB::schedule(uint32_t id, routine& r, int nresults)
+{
+	lua_State* thread = r.thread;
+	int base = lua_gettop(thread) - nresults + 1;
+
+	//a bare coroutine.yield() waits one frame
+	int kind = nresults >= 2 && lua_isinteger(thread, base) ? static_cast<int>(lua_tointeger(thread, base)) : WAIT_FRAMES;
+
+	if (kind == WAIT_SECONDS) {
+		float seconds = static_cast<float>(lua_tonumber(thread, base + 1));
+		time_queue.push({ current_time + std::max(seconds, 0.f), next_seq++, id });
+	}
+	else if (kind == WAIT_UNTIL) {
+		if (r.predicate_ref != LUA_NOREF) luaL_unref(thread, LUA_REGISTRYINDEX, r.predicate_ref);
+		lua_pushvalue(thread, base + 1);
+		r.predicate_ref = luaL_ref(thread, LUA_REGISTRYINDEX);
+		polling.push_back(id);
+	}
+	else {
+		int frames = nresults >= 2 ? static_cast<int>(lua_tointeger(thread, base + 1)) : 1;
+		frame_queue.push({ current_frame + std::max(frames, 1), next_seq++, id });
+	}
+
+	lua_pop(thread, nresults);
+}
+
+void CoroutineDB::finish(uint32_t id)
+{
+	auto it = routines.find(id);
+	if (it == routines.end()) return;
+
+	lua_State* L = ComponentDB::get_state();
+	routine& r = it->second;
+	if (r.predicate_ref != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, r.predicate_ref);
+	luaL_unref(L, LUA_REGISTRYINDEX, r.thread_ref);
+
+	if (r.owner != nullptr) {
+		auto owned = by_owner.find(r.owner);
+		if (owned != by_owner.end()) {
+			std::vector<uint32_t>& ids = owned->second;
+			ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+			if (ids.empty()) by_owner.erase(owned);
+		}
+	}
+
+	routines.erase(it);
+}
+
+void CoroutineDB::report(const char* message)
+{
+	std::string e_msg = message != nullptr ? message : "error in coroutine";
+	std::replace(e_msg.begin(), e_msg.end(), '\\', '/');
+	cout << "\033[31m" << "Coroutine : " << e_msg << "\033[0m" << endl;
+}
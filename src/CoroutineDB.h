@@ -0,0 +1,87 @@
+#ifndef COROUTINE_DB_H
+#define COROUTINE_DB_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//engine driven lua coroutines: Coroutine.Start(fn, ...) runs fn until it yields one of Wait.Frames(n),
+//Wait.Seconds(s) or Wait.Until(predicate). frame and time waits sit in wake queues ordered by due time and
+//are not touched until due; only Wait.Until predicates are polled every frame
+class CoroutineDB
+{
+public:
+	//registers the Coroutine and Wait namespaces
+	static void add_functions(lua_State* state);
+
+	//resumes every coroutine that is due at this frame / time (seconds since the scene started)
+	static void update(int frame, float now);
+
+	//stops coroutines started with one of a's components as their first argument
+	static void release(Actor* a);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	static inline const int WAIT_FRAMES = 1;
+	static inline const int WAIT_SECONDS = 2;
+	static inline const int WAIT_UNTIL = 3;
+
+	struct routine {
+		lua_State* thread;
+		int thread_ref;					//keeps the thread alive while it is scheduled
+		int predicate_ref = LUA_NOREF;	//Wait.Until
+		Actor* owner = nullptr;
+	};
+
+	//min-heap entry; seq keeps coroutines due at the same moment in the order they went to sleep
+	template<typename T>
+	struct wake {
+		T due;
+		uint64_t seq;
+		uint32_t id;
+		bool operator>(const wake& other) const { return due != other.due ? due > other.due : seq > other.seq; }
+	};
+
+	static inline std::unordered_map<uint32_t, routine> routines;
+	static inline std::unordered_map<Actor*, std::vector<uint32_t>> by_owner;
+	static inline uint32_t next_id = 1;
+	static inline uint64_t next_seq = 0;
+
+	static inline std::priority_queue<wake<int>, std::vector<wake<int>>, std::greater<wake<int>>> frame_queue;
+	static inline std::priority_queue<wake<float>, std::vector<wake<float>>, std::greater<wake<float>>> time_queue;
+	static inline std::vector<uint32_t> polling;				//waiting on Wait.Until
+	static inline std::vector<uint32_t> due;
+
+	static inline int current_frame = 0;
+	static inline float current_time = 0.f;
+	static inline uint32_t running = 0;						//id of the coroutine being resumed, 0 if none
+	static inline bool stop_running = false;				//it called Coroutine.Stop on itself
+	static inline size_t resumed_last_frame = 0;
+
+	//lua: id = Coroutine.Start(fn, ...), Coroutine.Stop(id), Coroutine.IsRunning(id)
+	static int lua_start(lua_State* L);
+	static int lua_stop(lua_State* L);
+	static int lua_is_running(lua_State* L);
+
+	//lua: yield with a wait descriptor
+	static int lua_wait_frames(lua_State* L);
+	static int lua_wait_seconds(lua_State* L);
+	static int lua_wait_until(lua_State* L);
+
+	//runs id until its next yield (nargs values already on its stack) and queues it by what it waits on
+	static void resume(uint32_t id, int nargs);
+	static void schedule(uint32_t id, routine& r, int nresults);
+	static void finish(uint32_t id);
+
+	static void report(const char* message);
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <sstream>
 #include <cstdlib>
 #include <filesystem>
+#include <unordered_set>
 
 //external headers
 #include "glm/glm.hpp"
@@ -39,6 +40,11 @@
 #include "Consts.h"
 #include "Input.h"
 #include "ComponentDB.h"
+#include "ImageDB.h"
+#include "StartupGraph.h"
+#include "ShardDB.h"
+#include "LuaGC.h"
+#include "Profiler.h"
 
 
 
@@ -107,6 +113,7 @@ Engine::~Engine()
 	if (TextDB::is_init()) TextDB::deinit();
 	if (ImageDB::is_init()) ImageDB::deinit();
 	if (SceneDB::is_init()) SceneDB::deinit();
+	if (ShardDB::is_enabled()) ShardDB::deinit();
 	if (ComponentDB::is_init()) ComponentDB::deinit();
 }
 
@@ -128,68 +135,187 @@ void Engine::onStart()
 		exit(0);
 	}
 
-	ComponentDB::init();
+	//independent pieces overlap: file reads, script compilation and image decoding on workers; SDL, the renderer,
+	//the lua state and everything that can exit or sets engine state (config, json parsing) stay on this thread
+	StartupGraph startup;
 
-	// read messages from file and set member variables
+	string config_text;
+	string scene_text;
+	rapidjson::Document config;
 	rapidjson::Document d;
-	EngineUtils::ReadJsonFile(GAME_CONFIG_PATH, d);
-
 	string title = "";
-
-	//get game title
-	if (d.HasMember("game_title") && d["game_title"].IsString()) 
-		title = d["game_title"].GetString();
-
-	/* ----- Read map from file ----- */
-
-	if (d.HasMember("initial_scene") && d["initial_scene"].IsString())
-		scene_name = d["initial_scene"].GetString();
-
-	if (scene_name == "") {
-		cout << "error: initial_scene unspecified";
-		exit(0);
-	}
-
 	SDL_Color clear_color = { 255, 255, 255, 255 };
-
-	if (d.HasMember("clear_color_r") && d["clear_color_r"].IsInt())
-		clear_color.r = d["clear_color_r"].GetInt();
-	if (d.HasMember("clear_color_g") && d["clear_color_g"].IsInt())
-		clear_color.g = d["clear_color_g"].GetInt();
-	if (d.HasMember("clear_color_b") && d["clear_color_b"].IsInt())
-		clear_color.b = d["clear_color_b"].GetInt();
-
 	int scale = 1;
-	if (d.HasMember("global_scale") && d["global_scale"].IsInt())
-		scale = d["global_scale"].GetInt();
+	bool preload_components = true;
+	bool startup_report = false;
+	std::unordered_set<std::string> scene_types;
+	std::unordered_set<std::string> scene_strings;
+
+	size_t read_config_file = startup.add("config_file", StartupGraph::WORKER, [&]() {
+		EngineUtils::ReadFileText(GAME_CONFIG_PATH, config_text);
+	});
+
+	size_t read_config = startup.add("config", StartupGraph::MAIN, [&]() {
+		// read messages from file and set member variables
+		EngineUtils::ParseJsonText(GAME_CONFIG_PATH, config_text, config);
+
+		//false compiles every component file from source (to compare startup times)
+		if (config.HasMember("script_cache") && config["script_cache"].IsBool())
+			ComponentDB::set_script_cache(config["script_cache"].GetBool());
+
+		//component files otherwise run the first time a type is used, which may be mid game
+		if (config.HasMember("preload_scene_components") && config["preload_scene_components"].IsBool())
+			preload_components = config["preload_scene_components"].GetBool();
+
+		//worker lua states for component types with parallel = true (0 = everything on the main state)
+		if (config.HasMember("script_shards") && config["script_shards"].IsInt())
+			ShardDB::init(config["script_shards"].GetInt());
+
+		//"generational" leaves collection to lua's young / major cycles; "incremental" (the default) steps the
+		//collector after each present for at most gc_step_budget_us (0 = lua's own incremental pacing)
+		if (config.HasMember("gc_mode") && config["gc_mode"].IsString()) {
+			string gc_mode = config["gc_mode"].GetString();
+			if (gc_mode != "incremental" && gc_mode != "generational") {
+				cout << "error: gc_mode must be incremental or generational";
+				exit(0);
+			}
+			LuaGC::set_mode(gc_mode == "generational");
+		}
+		if (config.HasMember("gc_step_budget_us") && config["gc_step_budget_us"].IsInt())
+			LuaGC::set_step_budget(config["gc_step_budget_us"].GetInt());
+
+		//script profiler: on from the first frame, resources/profiles/profile_*.folded written on quit
+		bool profiler = false;
+		int profiler_sample_instructions = 0;
+		int profiler_summary_frames = 0;
+		int profiler_summary_top = 10;
+		if (config.HasMember("profiler") && config["profiler"].IsBool())
+			profiler = config["profiler"].GetBool();
+		if (config.HasMember("profiler_sample_instructions") && config["profiler_sample_instructions"].IsInt())
+			profiler_sample_instructions = config["profiler_sample_instructions"].GetInt();
+		if (config.HasMember("profiler_summary_frames") && config["profiler_summary_frames"].IsInt())
+			profiler_summary_frames = config["profiler_summary_frames"].GetInt();
+		if (config.HasMember("profiler_summary_top") && config["profiler_summary_top"].IsInt())
+			profiler_summary_top = config["profiler_summary_top"].GetInt();
+		Profiler::set_options(profiler, profiler_sample_instructions, profiler_summary_frames, profiler_summary_top);
+
+		if (config.HasMember("startup_report") && config["startup_report"].IsBool())
+			startup_report = config["startup_report"].GetBool();
+
+		//get game title
+		if (config.HasMember("game_title") && config["game_title"].IsString())
+			title = config["game_title"].GetString();
+
+		if (config.HasMember("initial_scene") && config["initial_scene"].IsString())
+			scene_name = config["initial_scene"].GetString();
+
+		if (scene_name == "") {
+			cout << "error: initial_scene unspecified";
+			exit(0);
+		}
 
-	/* ----- Read scene information from file ----- */ 
-	glm::ivec2 disp_res = { X_DEFAULT_RES, Y_DEFAULT_RES };
+		//check that scene file exists
+		if (!std::filesystem::exists(SCENES_FOLDER_PATH + scene_name + ".json")) {
+			cout << "error: " << scene_name << ".json missing";
+			exit(0);
+		}
 
-	string scene_path = SCENES_FOLDER_PATH + scene_name + ".json";
-	//check that scene file exists
-	if (!std::filesystem::exists(scene_path)) {
-		cout << "error: " << scene_name << ".json missing";
-		exit(0);
-	}
+		if (config.HasMember("clear_color_r") && config["clear_color_r"].IsInt())
+			clear_color.r = config["clear_color_r"].GetInt();
+		if (config.HasMember("clear_color_g") && config["clear_color_g"].IsInt())
+			clear_color.g = config["clear_color_g"].GetInt();
+		if (config.HasMember("clear_color_b") && config["clear_color_b"].IsInt())
+			clear_color.b = config["clear_color_b"].GetInt();
+
+		if (config.HasMember("global_scale") && config["global_scale"].IsInt())
+			scale = config["global_scale"].GetInt();
+
+		//spread first-time OnStarts over several frames (0 = no limit)
+		int start_budget_us = 0;
+		int start_budget_actors = 0;
+		if (config.HasMember("start_budget_us") && config["start_budget_us"].IsInt())
+			start_budget_us = config["start_budget_us"].GetInt();
+		if (config.HasMember("start_budget_actors") && config["start_budget_actors"].IsInt())
+			start_budget_actors = config["start_budget_actors"].GetInt();
+		SceneDB::set_start_budget(start_budget_us, start_budget_actors);
+
+		//camera-proximity sleeping, in world units
+		float activation_cell_size = 4.f;
+		float activation_margin = 2.f;
+		if (config.HasMember("activation_cell_size") && config["activation_cell_size"].IsNumber())
+			activation_cell_size = config["activation_cell_size"].GetFloat();
+		if (config.HasMember("activation_margin") && config["activation_margin"].IsNumber())
+			activation_margin = config["activation_margin"].GetFloat();
+		SceneDB::set_activation_params(activation_cell_size, activation_margin);
+
+		if (config.HasMember("spatial_cell_size") && config["spatial_cell_size"].IsNumber())
+			SceneDB::set_spatial_cell_size(config["spatial_cell_size"].GetFloat());
+	}, { read_config_file });
+
+	/* ----- Read scene information from file ----- */
+	size_t read_scene_file = startup.add("scene_file", StartupGraph::WORKER, [&]() {
+		EngineUtils::ReadFileText(SCENES_FOLDER_PATH + scene_name + ".json", scene_text);
+	}, { read_config });
+
+	size_t read_scene = startup.add("scene_json", StartupGraph::MAIN, [&]() {
+		EngineUtils::ParseJsonText(SCENES_FOLDER_PATH + scene_name + ".json", scene_text, d);
+
+		//if d has no layers, exit early
+		if (!(d.HasMember("layers") && d["layers"].IsArray())) {
+			cout << "Scene file has no layers... exiting";
+			exit(0);
+		}
+	}, { read_scene_file });
+
+	//reads template files, which may fail to parse
+	size_t scan_scene = startup.add("scan_scene", StartupGraph::MAIN, [&]() {
+		ComponentDB::collect_scene_references(d, scene_types, scene_strings);
+		if (!preload_components) scene_types.clear();
+	}, { read_scene });
+
+	//SDL subsystem init is not thread safe: video, then audio, both here
+	size_t init_video = startup.add("sdl_video", StartupGraph::MAIN, [&]() {
+		if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+			cout << "Failed to initialize video";
+			exit(0);
+		}
+	});
 
-	EngineUtils::ReadJsonFile(scene_path, d);
+	/* ----- Create Audio DB ----- */
+	size_t init_audio = startup.add("audio", StartupGraph::MAIN, [&]() { AudioDB::init(); }, { init_video });
 
-	//if d has no layers, exit early
-	if (!(d.HasMember("layers") && d["layers"].IsArray())) {
-		cout << "Scene file has no layers... exiting";
-		exit(0);
-	}
+	size_t init_components = startup.add("component_db", StartupGraph::MAIN, [&]() { ComponentDB::init(); }, { read_config });
+
+	size_t compile_scripts = startup.add("compile_scripts", StartupGraph::WORKER, [&]() {
+		ComponentDB::precompile_component_types(scene_types);
+	}, { init_components, scan_scene });
 
+	size_t decode_images = startup.add("decode_images", StartupGraph::WORKER, [&]() {
+		ImageDB::decode_images(scene_strings);
+	}, { scan_scene });
 
 	/* ----- Create Renderer ----- */
-	Renderer::init(d, title, clear_color, scale);
+	size_t init_renderer = startup.add("renderer", StartupGraph::MAIN, [&]() {
+		Renderer::init(d, title, clear_color, scale);
+	}, { read_scene, init_video });
 
-	/* ----- Create Audio DB ----- */
-	AudioDB::init();
+	size_t upload_images = startup.add("upload_images", StartupGraph::MAIN, [&]() {
+		ImageDB::upload_decoded();
+	}, { init_renderer, decode_images });
+
+	size_t load_components = startup.add("load_components", StartupGraph::MAIN, [&]() {
+		ComponentDB::load_component_types(scene_types);
+	}, { compile_scripts });
 
 	/* ----- Create Scene DB ----- */
-	SceneDB::init(d);
+	startup.add("scene", StartupGraph::MAIN, [&]() { SceneDB::init(d); }, { load_components, upload_images, init_audio });
+
+	startup.run();
+
+#ifdef DEBUG
+	startup_report = true;
+#endif
+	if (startup_report) startup.print_timeline();
 
 	is_running = true;
 }
@@ -220,6 +346,11 @@ void Engine::update()
 void Engine::render()
 {
 	Renderer::disp();
+
+	//the frame is on screen; collection time here comes out of the next frame's delay
+	LuaGC::step();
+
+	Profiler::end_frame();
 }
 
 
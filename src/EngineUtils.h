@@ -5,6 +5,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iterator>
 
 #include "rapidjson/filereadstream.h"
 #include "rapidjson/document.h"
@@ -36,6 +37,21 @@ public:
 		}
 	}
 
+	//ReadJsonFile in two steps, so the file read can run off the main thread; a missing file leaves out empty
+	static void ReadFileText(const std::string& path, std::string& out) {
+		std::ifstream file(path, std::ios::binary);
+		out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	static void ParseJsonText(const std::string& path, const std::string& text, rapidjson::Document& out_document) {
+		out_document.Parse(text.c_str(), text.size());
+
+		if (out_document.HasParseError()) {
+			cout << "error parsing json at [" << path << "]" << endl;
+			exit(0);
+		}
+	}
+
 	static void PrintMessageFromDocument(const std::string& member, rapidjson::Document& d) {
 		std::string out = "";
 		if (d.HasMember(member.c_str()) && d[member.c_str()].IsString())
@@ -0,0 +1,204 @@
+#include "EventDB.h"
+
+#include "Actor.h"
+#include "Interner.h"
+#include "ComponentDB.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void EventDB::add_functions(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Event")
+		.addFunction("Id", &EventDB::lua_id)
+		.addFunction("Subscribe", &EventDB::lua_subscribe)
+		.addFunction("Unsubscribe", &EventDB::lua_unsubscribe)
+		.addFunction("Publish", &EventDB::lua_publish)
+		.endNamespace();
+}
+
+void EventDB::deliver()
+{
+	delivered_last_frame = 0;
+
+	if (!queue.empty()) {
+		lua_State* L = ComponentDB::get_state();
+		std::vector<pending_event> batch;
+		batch.swap(queue);
+
+		for (const pending_event& e : batch) {
+			auto list = subscribers.find(e.event);
+			if (list != subscribers.end()) {
+
+				//subscribing from a callback appends; those subscribers start with the next event
+				size_t count = list->second.size();
+				for (size_t i = 0; i < count; ++i) {
+					int fn_ref = list->second[i].fn_ref;
+					if (fn_ref == LUA_NOREF) continue;
+
+					Profiler::zone zone(e.event, "Event", list->second[i].owner);
+					Actor::running_scope running(list->second[i].owner);
+					lua_rawgeti(L, LUA_REGISTRYINDEX, fn_ref);
+					lua_rawgeti(L, LUA_REGISTRYINDEX, e.payload_ref);
+					if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+						std::string e_msg = lua_tostring(L, -1);
+						std::replace(e_msg.begin(), e_msg.end(), '\\', '/');
+						cout << "\033[31m" << "Event " << Interner::get_string(e.event) << " : " << e_msg << "\033[0m" << endl;
+						lua_pop(L, 1);
+					}
+					++delivered_last_frame;
+
+					//the callback may have subscribed to this event and grown (moved) the list
+					list = subscribers.find(e.event);
+				}
+			}
+
+			if (e.payload_ref != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, e.payload_ref);
+		}
+	}
+
+	compact();
+}
+
+void EventDB::release(Actor* a)
+{
+	auto it = owned.find(a);
+	if (it == owned.end()) return;
+
+	std::vector<uint32_t> ids;
+	ids.swap(it->second);
+	owned.erase(it);
+
+	for (uint32_t id : ids) {
+		unsubscribe(id);
+	}
+}
+
+void EventDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("event_subscriptions", static_cast<double>(subscription_count));
+	out.emplace_back("events_queued", static_cast<double>(queue.size()));
+	out.emplace_back("event_calls", static_cast<double>(delivered_last_frame));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+int EventDB::lua_id(lua_State* L)
+{
+	lua_pushinteger(L, check_event(L, 1));
+	return 1;
+}
+
+int EventDB::lua_subscribe(lua_State* L)
+{
+	uint32_t event = check_event(L, 1);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+
+	//owner: the actor whose callback is running, or a component / actor passed explicitly; the subscription ends when
+	//it is destroyed
+	Actor* owner = Actor::get_running();
+	if (lua_istable(L, 3)) {
+		LuaRef actor = LuaRef::fromStack(L, 3)["actor"];
+		if (actor.isUserdata()) owner = actor.cast<Actor*>();
+	}
+	else if (lua_isuserdata(L, 3)) {
+		owner = luabridge::Stack<Actor*>::get(L, 3);
+	}
+
+	lua_pushvalue(L, 2);
+	int fn_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	uint32_t id = next_id++;
+	subscribers[event].push_back({ id, fn_ref, owner });
+	subscription_event.emplace(id, event);
+	if (owner != nullptr) owned[owner].push_back(id);
+	++subscription_count;
+
+	lua_pushinteger(L, id);
+	return 1;
+}
+
+int EventDB::lua_unsubscribe(lua_State* L)
+{
+	unsubscribe(static_cast<uint32_t>(luaL_checkinteger(L, 1)));
+	return 0;
+}
+
+int EventDB::lua_publish(lua_State* L)
+{
+	uint32_t event = check_event(L, 1);
+
+	//nobody listening: nothing to queue
+	if (!has_subscribers(event)) return 0;
+
+	int payload_ref = LUA_NOREF;
+	if (!lua_isnoneornil(L, 2)) {
+		lua_pushvalue(L, 2);
+		payload_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+
+	publish(event, payload_ref);
+	return 0;
+}
+
+uint32_t EventDB::check_event(lua_State* L, int idx)
+{
+	if (lua_type(L, idx) == LUA_TNUMBER) {
+		lua_Integer id = luaL_checkinteger(L, idx);
+		if (id < 0 || static_cast<size_t>(id) >= Interner::size())
+			luaL_error(L, "unknown event id %d", static_cast<int>(id));
+		return static_cast<uint32_t>(id);
+	}
+	return Interner::get_id(luaL_checkstring(L, idx));
+}
+
+void EventDB::unsubscribe(uint32_t id)
+{
+	auto it = subscription_event.find(id);
+	if (it == subscription_event.end()) return;
+
+	uint32_t event = it->second;
+	subscription_event.erase(it);
+
+	//only this event's list is searched
+	for (subscriber& s : subscribers[event]) {
+		if (s.id != id) continue;
+
+		luaL_unref(ComponentDB::get_state(), LUA_REGISTRYINDEX, s.fn_ref);
+		s.fn_ref = LUA_NOREF;
+		--subscription_count;
+
+		if (s.owner != nullptr) {
+			auto owner_ids = owned.find(s.owner);
+			if (owner_ids != owned.end()) {
+				std::vector<uint32_t>& ids = owner_ids->second;
+				ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+				if (ids.empty()) owned.erase(owner_ids);
+			}
+		}
+		break;
+	}
+	dirty.push_back(event);
+}
+
+void EventDB::compact()
+{
+	for (uint32_t event : dirty) {
+		auto list = subscribers.find(event);
+		if (list == subscribers.end()) continue;
+
+		std::vector<subscriber>& subs = list->second;
+		subs.erase(std::remove_if(subs.begin(), subs.end(),
+			[](const subscriber& s) { return s.fn_ref == LUA_NOREF; }), subs.end());
+		if (subs.empty()) subscribers.erase(list);
+	}
+	dirty.clear();
+}
@@ -0,0 +1,71 @@
+#ifndef EVENT_DB_H
+#define EVENT_DB_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//deferred publish / subscribe between scripts: Event.Publish queues, SceneDB::tick delivers the whole queue in one
+//batch after late update. events are interned ids (Event.Id(name), or a name that is interned on the way in) and
+//each id keeps its own subscriber list, so a publish only touches that event's subscribers
+class EventDB
+{
+public:
+	//registers the Event namespace
+	static void add_functions(lua_State* state);
+
+	//delivers everything published before this call; events published by subscribers wait for the next batch
+	static void deliver();
+
+	//queues event from C++ (ShardDB); payload_ref is a registry ref or LUA_NOREF, released once delivered
+	static bool has_subscribers(uint32_t event) {
+		auto list = subscribers.find(event);
+		return list != subscribers.end() && !list->second.empty();
+	}
+	static void publish(uint32_t event, int payload_ref) { queue.push_back({ event, payload_ref }); }
+
+	//drops a's subscriptions (SceneDB::cpp_destroy)
+	static void release(Actor* a);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	struct subscriber {
+		uint32_t id;
+		int fn_ref;				//LUA_NOREF once unsubscribed; the entry is dropped at the next compact
+		Actor* owner;
+	};
+
+	struct pending_event {
+		uint32_t event;
+		int payload_ref;		//LUA_NOREF for nil
+	};
+
+	static inline std::unordered_map<uint32_t, std::vector<subscriber>> subscribers;	//event -> subscribers
+	static inline std::unordered_map<uint32_t, uint32_t> subscription_event;			//subscription id -> event
+	static inline std::unordered_map<Actor*, std::vector<uint32_t>> owned;				//owner -> subscription ids
+	static inline std::vector<uint32_t> dirty;			//events with unsubscribed entries to drop
+	static inline uint32_t next_id = 1;
+
+	static inline std::vector<pending_event> queue;
+	static inline size_t delivered_last_frame = 0;
+	static inline size_t subscription_count = 0;
+
+	//lua: Event.Id(name), id = Event.Subscribe(event, fn, [owner]), Event.Unsubscribe(id), Event.Publish(event, [payload])
+	static int lua_id(lua_State* L);
+	static int lua_subscribe(lua_State* L);
+	static int lua_unsubscribe(lua_State* L);
+	static int lua_publish(lua_State* L);
+
+	static uint32_t check_event(lua_State* L, int idx);
+	static void unsubscribe(uint32_t id);
+	static void compact();
+};
+
+#endif
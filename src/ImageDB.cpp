@@ -42,6 +42,29 @@ SDL_Texture* ImageDB::get_image(const string& name)
 		return images[name];
 }
 
+void ImageDB::decode_images(const std::unordered_set<std::string>& names)
+{
+	for (const string& name : names) {
+		string path = IMAGES_FOLDER_PATH + name + ".png";
+		if (!std::filesystem::exists(path)) continue;
+
+		SDL_Surface* surface = IMG_Load(path.c_str());
+		if (surface != nullptr) decoded.emplace_back(name, surface);
+	}
+}
+
+void ImageDB::upload_decoded()
+{
+	check_init();
+
+	for (const auto& image : decoded) {
+		if (images.count(image.first) == 0)
+			images.emplace(image.first, SDL_CreateTextureFromSurface(r, image.second));
+		SDL_FreeSurface(image.second);
+	}
+	decoded.clear();
+}
+
 /* ------------------------ private ------------------------ */
 
 SDL_Texture* ImageDB::create_image(const string& name)
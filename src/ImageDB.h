@@ -2,6 +2,9 @@
 #define IMAGE_DB_H
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <utility>
 
 #include "SDL2/SDL.h"
 #include "SDL_image/SDL_image.h"
@@ -15,6 +18,11 @@ public:
 
 	static SDL_Texture* get_image(const std::string& name);
 
+	//decodes the names that are images in IMAGES_FOLDER_PATH; needs no renderer, so it can run on a worker before init
+	static void decode_images(const std::unordered_set<std::string>& names);
+	//turns what decode_images produced into textures (main thread, after init)
+	static void upload_decoded();
+
 
 	static bool is_init() { return initialized; }
 
@@ -22,6 +30,7 @@ private:
 
 
 	static inline std::unordered_map<std::string, SDL_Texture*> images;
+	static inline std::vector<std::pair<std::string, SDL_Surface*>> decoded;
 	static inline SDL_Renderer* r = nullptr;
 	static inline bool initialized = false;
 
@@ -0,0 +1,44 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+//maps strings that repeat across many actors (component types, template keys) to small integer ids
+class Interner
+{
+public:
+	static inline const uint32_t INVALID_ID = UINT32_MAX;
+
+	//returns the id of s, interning it if it has not been seen before
+	static uint32_t get_id(std::string_view s) {
+		auto it = ids.find(s);
+		if (it != ids.end()) return it->second;
+
+		uint32_t id = static_cast<uint32_t>(strings.size());
+		strings.emplace_back(s);
+		ids.emplace(strings.back(), id);
+		return id;
+	}
+
+	//returns the id of s, or INVALID_ID if s was never interned
+	static uint32_t find_id(std::string_view s) {
+		auto it = ids.find(s);
+		if (it == ids.end()) return INVALID_ID;
+		return it->second;
+	}
+
+	static const std::string& get_string(uint32_t id) { return strings[id]; }
+
+	static size_t size() { return strings.size(); }
+
+private:
+	//keys view the strings below, so lookups from a lua string (lua_tolstring) need no std::string
+	static inline std::unordered_map<std::string_view, uint32_t> ids;
+	static inline std::deque<std::string> strings;	//deque so returned references (and the views above) stay valid as we grow
+};
+
+#endif
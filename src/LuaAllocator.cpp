@@ -0,0 +1,248 @@
+#include "LuaAllocator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#ifdef DEBUG
+#include "SDL2/SDL.h"
+#endif
+
+using std::cout;
+using std::endl;
+
+void* LuaAllocator::alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+	LuaAllocator* self = static_cast<LuaAllocator*>(ud);
+
+	if (nsize == 0) {
+		if (ptr != nullptr) self->deallocate(ptr, osize);
+		return nullptr;
+	}
+
+	//with a null ptr, osize is the type of object being created rather than a size
+	if (ptr == nullptr) {
+		self->allocated_total += nsize;
+		return self->allocate(nsize);
+	}
+	if (nsize > osize) self->allocated_total += nsize - osize;
+
+	if (osize > MAX_SMALL && nsize > MAX_SMALL) {
+		void* moved = std::realloc(ptr, nsize);
+		if (moved == nullptr) return nullptr;
+		self->large_live_bytes = self->large_live_bytes - osize + nsize;
+		self->live_bytes = self->live_bytes - osize + nsize;
+		self->peak_bytes = std::max(self->peak_bytes, self->live_bytes);
+		return moved;
+	}
+
+	//still fits the same block
+	if (osize <= MAX_SMALL && nsize <= MAX_SMALL && class_of(osize) == class_of(nsize)) {
+		self->live_bytes = self->live_bytes - osize + nsize;
+		self->peak_bytes = std::max(self->peak_bytes, self->live_bytes);
+		return ptr;
+	}
+
+	void* moved = self->allocate(nsize);
+	if (moved == nullptr) return nullptr;
+	std::memcpy(moved, ptr, std::min(osize, nsize));
+	self->deallocate(ptr, osize);
+	return moved;
+}
+
+void LuaAllocator::release()
+{
+	for (void* slab : slabs) {
+		std::free(slab);
+	}
+	slabs.clear();
+
+	for (size_class& c : classes) {
+		c = size_class();
+	}
+	live_bytes = 0;
+	peak_bytes = 0;
+	large_allocs = 0;
+	large_live_bytes = 0;
+}
+
+void LuaAllocator::collect_stats(std::vector<std::pair<std::string, double>>& out) const
+{
+	size_t small_allocs = 0;
+	for (const size_class& c : classes) {
+		small_allocs += c.allocs;
+	}
+
+	out.emplace_back("lua_bytes", static_cast<double>(live_bytes));
+	out.emplace_back("lua_peak_bytes", static_cast<double>(peak_bytes));
+	out.emplace_back("lua_slab_bytes", static_cast<double>(slabs.size() * SLAB_BYTES));
+	out.emplace_back("lua_large_bytes", static_cast<double>(large_live_bytes));
+	out.emplace_back("lua_small_allocs", static_cast<double>(small_allocs));
+	out.emplace_back("lua_large_allocs", static_cast<double>(large_allocs));
+
+	//only the classes the scripts actually use
+	for (size_t i = 0; i < CLASS_COUNT; ++i) {
+		if (classes[i].allocs == 0) continue;
+		std::string size = std::to_string(CLASS_SIZES[i]);
+		out.emplace_back("lua_class_" + size + "_allocs", static_cast<double>(classes[i].allocs));
+		out.emplace_back("lua_class_" + size + "_live", static_cast<double>(classes[i].live));
+	}
+}
+
+#ifdef DEBUG
+namespace {
+	//the same as lauxlib's l_alloc, which luaL_newstate uses
+	void* default_alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+	{
+		size_t* count = static_cast<size_t*>(ud);
+		if (nsize == 0) {
+			std::free(ptr);
+			return nullptr;
+		}
+		++*count;
+		return std::realloc(ptr, nsize);
+	}
+
+	//actors with a few components each: per frame updates that churn small tables, closures and strings, plus respawns
+	const char* BENCHMARK_SCRIPT = R"(
+		local Mover = {}
+		Mover.__index = Mover
+		function Mover:OnUpdate(dt)
+			self.x = self.x + self.vx * dt
+			self.y = self.y + self.vy * dt
+			local p = { x = self.x, y = self.y }
+			self.trail[(self.step % 8) + 1] = p
+			self.step = self.step + 1
+			self.label = "mover_" .. (self.id % 64)
+		end
+
+		local function spawn(id)
+			local actor = { id = id, components = {} }
+			for c = 1, COMPONENTS do
+				actor.components[c] = setmetatable({
+					id = id * COMPONENTS + c, x = 0, y = 0, vx = c, vy = -c, step = 0, trail = {},
+					on_hit = function(other) return id + other end
+				}, Mover)
+			end
+			return actor
+		end
+
+		local actors = {}
+		for i = 1, ACTORS do actors[i] = spawn(i) end
+
+		for frame = 1, FRAMES do
+			for i = 1, ACTORS do
+				for _, comp in ipairs(actors[i].components) do comp:OnUpdate(0.016) end
+			end
+			for k = 1, ACTORS // 20 do
+				local i = math.random(ACTORS)
+				actors[i] = spawn(i + frame * ACTORS)
+			end
+		end
+	)";
+
+	double run_workload(lua_State* L)
+	{
+		luaL_openlibs(L);
+		lua_pushinteger(L, 5000);
+		lua_setglobal(L, "ACTORS");
+		lua_pushinteger(L, 4);
+		lua_setglobal(L, "COMPONENTS");
+		lua_pushinteger(L, 120);
+		lua_setglobal(L, "FRAMES");
+
+		uint64_t t0 = SDL_GetPerformanceCounter();
+		if (luaL_dostring(L, BENCHMARK_SCRIPT) != LUA_OK) {
+			cout << "error: allocator benchmark failed: " << lua_tostring(L, -1) << endl;
+		}
+		lua_close(L);
+		uint64_t t1 = SDL_GetPerformanceCounter();
+
+		return (t1 - t0) / static_cast<double>(SDL_GetPerformanceFrequency()) * 1000.0;
+	}
+}
+
+void LuaAllocator::benchmark()
+{
+	size_t default_allocs = 0;
+	double default_ms = run_workload(lua_newstate(&default_alloc, &default_allocs));
+
+	LuaAllocator pooled;
+	double pooled_ms = run_workload(lua_newstate(&LuaAllocator::alloc, &pooled));
+
+	size_t small_allocs = 0;
+	for (const size_class& c : pooled.classes) {
+		small_allocs += c.allocs;
+	}
+
+	cout << "lua allocator, 5000 actors x 4 components x 120 frames: default " << default_ms << " ms (" << default_allocs
+		<< " allocs), pooled " << pooled_ms << " ms (" << small_allocs << " small / " << pooled.large_allocs << " large allocs, "
+		<< pooled.slabs.size() * SLAB_BYTES / 1024 << " KB of slabs, peak " << pooled.peak_bytes / 1024 << " KB)" << endl;
+
+	pooled.release();
+}
+#endif
+
+
+/* ------------------------ private ------------------------ */
+
+void* LuaAllocator::allocate(size_t nsize)
+{
+	void* block;
+
+	if (nsize > MAX_SMALL) {
+		block = std::malloc(nsize);
+		if (block == nullptr) return nullptr;
+		++large_allocs;
+		large_live_bytes += nsize;
+	}
+	else {
+		size_t index = class_of(nsize);
+		size_class& c = classes[index];
+		if (c.free == nullptr && !refill(c, CLASS_SIZES[index])) return nullptr;
+
+		block = c.free;
+		c.free = c.free->next;
+		++c.allocs;
+		++c.live;
+	}
+
+	live_bytes += nsize;
+	peak_bytes = std::max(peak_bytes, live_bytes);
+	return block;
+}
+
+void LuaAllocator::deallocate(void* ptr, size_t osize)
+{
+	live_bytes -= osize;
+
+	if (osize > MAX_SMALL) {
+		large_live_bytes -= osize;
+		std::free(ptr);
+		return;
+	}
+
+	size_class& c = classes[class_of(osize)];
+	free_block* block = static_cast<free_block*>(ptr);
+	block->next = c.free;
+	c.free = block;
+	--c.live;
+}
+
+bool LuaAllocator::refill(size_class& c, size_t block_size)
+{
+	//malloc alignment covers every class since they are all multiples of 16
+	char* slab = static_cast<char*>(std::malloc(SLAB_BYTES));
+	if (slab == nullptr) return false;
+	slabs.push_back(slab);
+
+	//thread the slab's blocks onto the free list in address order
+	size_t count = SLAB_BYTES / block_size;
+	for (size_t i = count; i-- > 0;) {
+		free_block* block = reinterpret_cast<free_block*>(slab + i * block_size);
+		block->next = c.free;
+		c.free = block;
+	}
+	return true;
+}
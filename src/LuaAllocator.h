@@ -0,0 +1,73 @@
+#ifndef LUA_ALLOCATOR_H
+#define LUA_ALLOCATOR_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+//lua_Alloc for the script VM: blocks up to MAX_SMALL bytes come from per size class free lists carved out of
+//64KB slabs, bigger ones go to realloc/free. lua passes the old size on every resize and free, so blocks carry no header
+class LuaAllocator
+{
+public:
+	//pass as lua_newstate(&LuaAllocator::alloc, &allocator)
+	static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+	//returns every slab to the system; only after lua_close on the state using this allocator
+	void release();
+
+	void collect_stats(std::vector<std::pair<std::string, double>>& out) const;
+
+	//bytes handed to lua since startup (growth only; frees do not count against it)
+	uint64_t get_allocated_total() const { return allocated_total; }
+
+#ifdef DEBUG
+	//times a component-style script workload on the default allocator and on this one
+	static void benchmark();
+#endif
+
+private:
+	static constexpr size_t MAX_SMALL = 512;
+	static constexpr size_t SLAB_BYTES = 64 * 1024;
+	static constexpr size_t CLASS_COUNT = 16;
+	static constexpr size_t CLASS_SIZES[CLASS_COUNT] = { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+
+	struct free_block {
+		free_block* next;
+	};
+
+	struct size_class {
+		free_block* free = nullptr;
+		size_t allocs = 0;		//blocks handed out since startup
+		size_t live = 0;		//blocks currently in use
+	};
+
+	size_class classes[CLASS_COUNT];
+	std::vector<void*> slabs;
+
+	size_t live_bytes = 0;		//as requested by lua, small and large
+	size_t peak_bytes = 0;
+	uint64_t allocated_total = 0;
+	size_t large_allocs = 0;
+	size_t large_live_bytes = 0;
+
+	//size class of a small block, from its size in 16 byte steps
+	static size_t class_of(size_t size) {
+		static constexpr uint8_t LOOKUP[MAX_SMALL / 16 + 1] = {
+			0, 0, 1, 2, 3, 4, 5, 6, 7,
+			8, 8, 9, 9, 10, 10, 11, 11,
+			12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15
+		};
+		return LOOKUP[(size + 15) >> 4];
+	}
+
+	void* allocate(size_t nsize);
+	void deallocate(void* ptr, size_t osize);
+	bool refill(size_class& c, size_t block_size);
+};
+
+#endif
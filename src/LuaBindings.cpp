@@ -0,0 +1,426 @@
+#include "LuaBindings.h"
+
+#include "LuaBridge/LuaBridge.h"
+
+#include "Actor.h"
+#include "Transform.h"
+#include "Input.h"
+#include "Renderer.h"
+#include "ComponentStore.h"
+#include "Interner.h"
+
+#include "Helper.h"
+#include "keycode_to_scancode.h"
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+void LuaBindings::add_functions(lua_State* state)
+{
+	if (scancodes.empty()) {
+		for (const auto& entry : __keycode_to_scancode) {
+			scancodes.emplace(entry.first, entry.second);
+		}
+	}
+
+#ifdef DEBUG
+	lua_newtable(state);
+	bridge_functions = luaL_ref(state, LUA_REGISTRYINDEX);
+#endif
+
+	struct entry {
+		const char* name;
+		lua_CFunction fn;
+	};
+	struct group {
+		const char* owner;
+		std::vector<entry> entries;
+	};
+
+	const group NAMESPACES[] = {
+		{ "Input", {
+			{ "GetKey", &lua_get_key },
+			{ "GetKeyDown", &lua_get_key_down },
+			{ "GetKeyUp", &lua_get_key_up },
+			{ "GetMouseButton", &lua_get_mouse_button },
+			{ "GetMouseButtonDown", &lua_get_mouse_button_down },
+			{ "GetMouseButtonUp", &lua_get_mouse_button_up },
+			{ "GetMousePosition", &lua_get_mouse_position },
+			{ "GetMouseScrollDelta", &lua_get_mouse_scroll_delta } } },
+		{ "Image", {
+			{ "Draw", &lua_draw },
+			{ "DrawEx", &lua_draw_ex },
+			{ "DrawUI", &lua_draw_ui },
+			{ "DrawUIEx", &lua_draw_ui_ex },
+			{ "DrawPixel", &lua_draw_pixel } } },
+		{ "Camera", {
+			{ "SetPosition", &lua_set_camera_position },
+			{ "GetPositionX", &lua_get_camera_x },
+			{ "GetPositionY", &lua_get_camera_y },
+			{ "GetZoom", &lua_get_camera_zoom } } },
+		{ "Application", { { "GetFrame", &lua_get_frame } } },
+		{ "Debug", { { "Log", &lua_log } } },
+	};
+
+	for (const group& g : NAMESPACES) {
+		lua_getglobal(state, g.owner);
+		for (const entry& e : g.entries) {
+			replace(state, -1, g.owner, e.name, e.fn);
+		}
+		lua_pop(state, 1);
+	}
+
+	//methods live in the class metatable (LuaBridge's __index looks there before the property getters)
+	lua_rawgetp(state, LUA_REGISTRYINDEX, luabridge::detail::getClassRegistryKey<Actor>());
+	replace(state, -1, "Actor", "GetComponent", &lua_actor_get_component);
+	replace(state, -1, "Actor", "GetName", &lua_actor_get_name);
+	replace(state, -1, "Actor", "GetID", &lua_actor_get_id);
+	replace(state, -1, "Actor", "GetTransform", &lua_actor_get_transform);
+	lua_pop(state, 1);
+
+	lua_rawgetp(state, LUA_REGISTRYINDEX, luabridge::detail::getClassRegistryKey<Transform>());
+	replace(state, -1, "Transform", "GetPositionXY", &lua_transform_get_position_xy);
+	replace(state, -1, "Transform", "SetPositionXY", &lua_transform_set_position_xy);
+	lua_pop(state, 1);
+}
+
+#ifdef DEBUG
+int LuaBindings::lua_benchmark(lua_State* L)
+{
+	const int CALLS = 200000;
+
+	bool has_actor = lua_isuserdata(L, 1) && lua_isstring(L, 2);
+	bool has_image = lua_isstring(L, 3);
+
+	//each case is the body of a loop; f is the function under test, a the actor, img the image
+	struct bench_case {
+		const char* owner;
+		const char* name;
+		const char* call;
+		bool actor;
+		bool image;
+	};
+	const bench_case CASES[] = {
+		{ "Input", "GetKey", "f('space')", false, false },
+		{ "Input", "GetKeyDown", "f('left')", false, false },
+		{ "Input", "GetMouseButton", "f(1)", false, false },
+		{ "Input", "GetMousePosition", "f()", false, false },
+		{ "Camera", "GetPositionX", "f()", false, false },
+		{ "Camera", "SetPosition", "f(1.5, 2.5)", false, false },
+		{ "Application", "GetFrame", "f()", false, false },
+		{ "Actor", "GetComponent", "f(a, type)", true, false },
+		{ "Actor", "GetName", "f(a)", true, false },
+		{ "Actor", "GetID", "f(a)", true, false },
+		{ "Actor", "GetTransform", "f(a)", true, false },
+		{ "Image", "Draw", "f(img, 1, 2)", false, true },
+		{ "Image", "DrawEx", "f(img, 1, 2, 45, 1, 1, 0.5, 0.5, 255, 128, 0, 255, 3)", false, true },
+		{ "Image", "DrawUI", "f(img, 10, 20)", false, true },
+	};
+
+	double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+	auto run = [&](const bench_case& c, int fn_idx) {
+		std::string code = std::string("local f, a, type, img, n = ...\nfor i = 1, n do ") + c.call + " end";
+		if (luaL_loadstring(L, code.c_str()) != LUA_OK) {
+			cout << "error: binding benchmark " << c.owner << "." << c.name << ": " << lua_tostring(L, -1) << endl;
+			lua_pop(L, 1);
+			return 0.0;
+		}
+		lua_pushvalue(L, fn_idx);
+		lua_pushvalue(L, 1);
+		lua_pushvalue(L, 2);
+		lua_pushvalue(L, 3);
+		lua_pushinteger(L, CALLS);
+
+		uint64_t t0 = SDL_GetPerformanceCounter();
+		if (lua_pcall(L, 5, 0, 0) != LUA_OK) {
+			cout << "error: binding benchmark " << c.owner << "." << c.name << ": " << lua_tostring(L, -1) << endl;
+			lua_pop(L, 1);
+			return 0.0;
+		}
+		uint64_t t1 = SDL_GetPerformanceCounter();
+
+		if (c.image) Renderer::discard_frame();
+		return CALLS / ((t1 - t0) / freq);
+	};
+
+	cout << "binding calls per second (" << CALLS << " calls each): LuaBridge -> raw" << endl;
+	for (const bench_case& c : CASES) {
+		if ((c.actor && !has_actor) || (c.image && !has_image)) continue;
+
+		std::string key = std::string(c.owner) + "." + c.name;
+		lua_rawgeti(L, LUA_REGISTRYINDEX, bridge_functions);
+		lua_getfield(L, -1, key.c_str());
+		lua_remove(L, -2);
+		int bridge_idx = lua_gettop(L);
+
+		if (std::string(c.owner) == "Actor") lua_rawgetp(L, LUA_REGISTRYINDEX, luabridge::detail::getClassRegistryKey<Actor>());
+		else lua_getglobal(L, c.owner);
+		lua_getfield(L, -1, c.name);
+		lua_remove(L, -2);
+		int raw_idx = lua_gettop(L);
+
+		double bridge = run(c, bridge_idx);
+		double raw = run(c, raw_idx);
+		cout << "  " << key << ": " << static_cast<uint64_t>(bridge) << " -> " << static_cast<uint64_t>(raw)
+			<< " (x" << (bridge > 0.0 ? raw / bridge : 0.0) << ")" << endl;
+		lua_pop(L, 2);
+	}
+	return 0;
+}
+#endif
+
+
+/* ------------------------ private ------------------------ */
+
+void LuaBindings::replace(lua_State* L, int idx, [[maybe_unused]] const char* owner, const char* name, lua_CFunction fn)
+{
+	idx = lua_absindex(L, idx);
+
+#ifdef DEBUG
+	lua_rawgeti(L, LUA_REGISTRYINDEX, bridge_functions);
+	lua_pushstring(L, name);
+	lua_rawget(L, idx);
+	lua_setfield(L, -2, (std::string(owner) + "." + name).c_str());
+	lua_pop(L, 1);
+#endif
+
+	lua_pushstring(L, name);
+	lua_pushcfunction(L, fn);
+	lua_rawset(L, idx);
+}
+
+SDL_Scancode LuaBindings::check_scancode(lua_State* L, int idx)
+{
+	size_t len;
+	const char* code = luaL_checklstring(L, idx, &len);
+	auto it = scancodes.find(std::string_view(code, len));
+	return it == scancodes.end() ? SDL_SCANCODE_UNKNOWN : it->second;
+}
+
+SDL_Texture* LuaBindings::check_image(lua_State* L, int idx)
+{
+	//image names are few, so interning them from scripts is fine; the texture is cached per id
+	size_t len;
+	const char* name = luaL_checklstring(L, idx, &len);
+	return ComponentStore::get_image_info(Interner::get_id(std::string_view(name, len))).tex;
+}
+
+Actor* LuaBindings::check_actor(lua_State* L)
+{
+	//LuaBridge's class check (raises on a wrong type); nil would otherwise reach us as nullptr
+	Actor* a = luabridge::detail::Userdata::get<Actor>(L, 1, false);
+	if (a == nullptr) luaL_argerror(L, 1, "Actor expected, got nil");
+	return a;
+}
+
+Transform* LuaBindings::check_transform(lua_State* L, bool can_be_const)
+{
+	Transform* t = luabridge::detail::Userdata::get<Transform>(L, 1, can_be_const);
+	if (t == nullptr) luaL_argerror(L, 1, "Transform expected, got nil");
+	return t;
+}
+
+uint8_t LuaBindings::check_channel(lua_State* L, int idx)
+{
+	lua_Number v = luaL_checknumber(L, idx);
+	return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+int LuaBindings::lua_get_key(lua_State* L)
+{
+	SDL_Scancode code = check_scancode(L, 1);
+	lua_pushboolean(L, code != SDL_SCANCODE_UNKNOWN && Input::GetKey(code));
+	return 1;
+}
+
+int LuaBindings::lua_get_key_down(lua_State* L)
+{
+	SDL_Scancode code = check_scancode(L, 1);
+	lua_pushboolean(L, code != SDL_SCANCODE_UNKNOWN && Input::GetKeyDown(code));
+	return 1;
+}
+
+int LuaBindings::lua_get_key_up(lua_State* L)
+{
+	SDL_Scancode code = check_scancode(L, 1);
+	lua_pushboolean(L, code != SDL_SCANCODE_UNKNOWN && Input::GetKeyUp(code));
+	return 1;
+}
+
+int LuaBindings::lua_get_mouse_button(lua_State* L)
+{
+	lua_pushboolean(L, Input::GetMouseButton(static_cast<int>(luaL_checkinteger(L, 1))));
+	return 1;
+}
+
+int LuaBindings::lua_get_mouse_button_down(lua_State* L)
+{
+	lua_pushboolean(L, Input::GetMouseButtonDown(static_cast<int>(luaL_checkinteger(L, 1))));
+	return 1;
+}
+
+int LuaBindings::lua_get_mouse_button_up(lua_State* L)
+{
+	lua_pushboolean(L, Input::GetMouseButtonUp(static_cast<int>(luaL_checkinteger(L, 1))));
+	return 1;
+}
+
+int LuaBindings::lua_get_mouse_position(lua_State* L)
+{
+	luabridge::Stack<glm::vec2>::push(L, Input::GetMousePosition());
+	return 1;
+}
+
+int LuaBindings::lua_get_mouse_scroll_delta(lua_State* L)
+{
+	lua_pushnumber(L, Input::GetMouseScrollDelta());
+	return 1;
+}
+
+int LuaBindings::lua_draw(lua_State* L)
+{
+	SDL_Texture* tex = check_image(L, 1);
+	float x = static_cast<float>(luaL_checknumber(L, 2));
+	float y = static_cast<float>(luaL_checknumber(L, 3));
+	Renderer::queue_sprite(tex, x, y, 0.f, 1.f, 1.f, 0.5f, 0.5f, 255, 255, 255, 255, 0);
+	return 0;
+}
+
+int LuaBindings::lua_draw_ex(lua_State* L)
+{
+	SDL_Texture* tex = check_image(L, 1);
+	float x = static_cast<float>(luaL_checknumber(L, 2));
+	float y = static_cast<float>(luaL_checknumber(L, 3));
+	float rotation = static_cast<float>(luaL_checknumber(L, 4));
+	float scale_x = static_cast<float>(luaL_checknumber(L, 5));
+	float scale_y = static_cast<float>(luaL_checknumber(L, 6));
+	float pivot_x = static_cast<float>(luaL_checknumber(L, 7));
+	float pivot_y = static_cast<float>(luaL_checknumber(L, 8));
+	uint8_t r = check_channel(L, 9);
+	uint8_t g = check_channel(L, 10);
+	uint8_t b = check_channel(L, 11);
+	uint8_t a = check_channel(L, 12);
+	int order = static_cast<int>(luaL_checknumber(L, 13));
+	Renderer::queue_sprite(tex, x, y, rotation, scale_x, scale_y, pivot_x, pivot_y, r, g, b, a, order);
+	return 0;
+}
+
+int LuaBindings::lua_draw_ui(lua_State* L)
+{
+	SDL_Texture* tex = check_image(L, 1);
+	Renderer::queue_UI(tex, static_cast<float>(luaL_checknumber(L, 2)), static_cast<float>(luaL_checknumber(L, 3)), 255, 255, 255, 255, 0);
+	return 0;
+}
+
+int LuaBindings::lua_draw_ui_ex(lua_State* L)
+{
+	SDL_Texture* tex = check_image(L, 1);
+	float x = static_cast<float>(luaL_checknumber(L, 2));
+	float y = static_cast<float>(luaL_checknumber(L, 3));
+	uint8_t r = check_channel(L, 4);
+	uint8_t g = check_channel(L, 5);
+	uint8_t b = check_channel(L, 6);
+	uint8_t a = check_channel(L, 7);
+	Renderer::queue_UI(tex, x, y, r, g, b, a, static_cast<int>(luaL_checknumber(L, 8)));
+	return 0;
+}
+
+int LuaBindings::lua_draw_pixel(lua_State* L)
+{
+	Renderer::draw_pixel(static_cast<float>(luaL_checknumber(L, 1)), static_cast<float>(luaL_checknumber(L, 2)),
+		check_channel(L, 3), check_channel(L, 4), check_channel(L, 5), check_channel(L, 6));
+	return 0;
+}
+
+int LuaBindings::lua_set_camera_position(lua_State* L)
+{
+	Renderer::set_camera_pos(static_cast<float>(luaL_checknumber(L, 1)), static_cast<float>(luaL_checknumber(L, 2)));
+	return 0;
+}
+
+int LuaBindings::lua_get_camera_x(lua_State* L)
+{
+	lua_pushnumber(L, Renderer::get_camera_posX());
+	return 1;
+}
+
+int LuaBindings::lua_get_camera_y(lua_State* L)
+{
+	lua_pushnumber(L, Renderer::get_camera_posY());
+	return 1;
+}
+
+int LuaBindings::lua_get_camera_zoom(lua_State* L)
+{
+	lua_pushnumber(L, Renderer::get_camera_zoom());
+	return 1;
+}
+
+int LuaBindings::lua_get_frame(lua_State* L)
+{
+	lua_pushinteger(L, Helper::GetFrameNumber());
+	return 1;
+}
+
+int LuaBindings::lua_log(lua_State* L)
+{
+	//any value, through __tostring like print
+	size_t len;
+	const char* message = luaL_tolstring(L, 1, &len);
+	cout.write(message, len);
+	cout << endl;
+	return 0;
+}
+
+int LuaBindings::lua_actor_get_component(lua_State* L)
+{
+	Actor* a = check_actor(L);
+	size_t len;
+	const char* type = luaL_checklstring(L, 2, &len);
+
+	const luabridge::LuaRef* comp = a->find_component(Interner::find_id(std::string_view(type, len)));
+	if (comp == nullptr) lua_pushnil(L);
+	else comp->push(L);
+	return 1;
+}
+
+int LuaBindings::lua_actor_get_name(lua_State* L)
+{
+	Actor* a = check_actor(L);
+	lua_pushlstring(L, a->name.data(), a->name.size());
+	return 1;
+}
+
+int LuaBindings::lua_actor_get_id(lua_State* L)
+{
+	Actor* a = check_actor(L);
+	lua_pushinteger(L, a->id);
+	return 1;
+}
+
+int LuaBindings::lua_actor_get_transform(lua_State* L)
+{
+	Actor* a = check_actor(L);
+	luabridge::Stack<Transform&>::push(L, a->get_transform());
+	return 1;
+}
+
+int LuaBindings::lua_transform_get_position_xy(lua_State* L)
+{
+	Transform* t = check_transform(L, true);
+	lua_pushnumber(L, t->position.x);
+	lua_pushnumber(L, t->position.y);
+	return 2;
+}
+
+int LuaBindings::lua_transform_set_position_xy(lua_State* L)
+{
+	Transform* t = check_transform(L, false);
+	t->position = glm::vec2(static_cast<float>(luaL_checknumber(L, 2)), static_cast<float>(luaL_checknumber(L, 3)));
+	t->mark_moved();
+	return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef LUA_BINDINGS_H
+#define LUA_BINDINGS_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "SDL2/SDL.h"
+
+class Actor;
+class Transform;
+
+//hand-written lua_CFunctions for the bindings scripts call every frame (input polling, immediate-mode drawing,
+//camera, GetComponent). they replace the LuaBridge thunks registered by ComponentDB under the same names: strings are
+//read in place with lua_tolstring and looked up through string_view maps, images resolve to a cached texture instead
+//of a queued name, and GetComponent pushes the component from its existing ref instead of copying a LuaRef
+class LuaBindings
+{
+public:
+	//overwrites the LuaBridge versions; call after ComponentDB::add_global_classes / add_global_functions
+	static void add_functions(lua_State* state);
+
+#ifdef DEBUG
+	//lua: Debug.BenchmarkBindings([actor, component type], [image]) prints calls per second for each replaced
+	//binding, LuaBridge thunk vs raw function; the Actor and Image rows need the optional arguments
+	static int lua_benchmark(lua_State* L);
+#endif
+
+private:
+	static inline std::unordered_map<std::string_view, SDL_Scancode> scancodes;		//views the keys of __keycode_to_scancode
+
+#ifdef DEBUG
+	static inline int bridge_functions = LUA_NOREF;		//registry table: "Namespace.Name" -> the LuaBridge function replaced
+#endif
+
+	//replaces table[name] (a namespace table or a class metatable, at idx) with fn; owner.name is only for the benchmark
+	static void replace(lua_State* L, int idx, const char* owner, const char* name, lua_CFunction fn);
+
+	static SDL_Scancode check_scancode(lua_State* L, int idx);
+	static SDL_Texture* check_image(lua_State* L, int idx);
+	static uint8_t check_channel(lua_State* L, int idx);
+	static Actor* check_actor(lua_State* L);
+	static Transform* check_transform(lua_State* L, bool can_be_const);
+
+	//Input
+	static int lua_get_key(lua_State* L);
+	static int lua_get_key_down(lua_State* L);
+	static int lua_get_key_up(lua_State* L);
+	static int lua_get_mouse_button(lua_State* L);
+	static int lua_get_mouse_button_down(lua_State* L);
+	static int lua_get_mouse_button_up(lua_State* L);
+	static int lua_get_mouse_position(lua_State* L);
+	static int lua_get_mouse_scroll_delta(lua_State* L);
+
+	//Image
+	static int lua_draw(lua_State* L);
+	static int lua_draw_ex(lua_State* L);
+	static int lua_draw_ui(lua_State* L);
+	static int lua_draw_ui_ex(lua_State* L);
+	static int lua_draw_pixel(lua_State* L);
+
+	//Camera, Application, Debug
+	static int lua_set_camera_position(lua_State* L);
+	static int lua_get_camera_x(lua_State* L);
+	static int lua_get_camera_y(lua_State* L);
+	static int lua_get_camera_zoom(lua_State* L);
+	static int lua_get_frame(lua_State* L);
+	static int lua_log(lua_State* L);
+
+	//Actor methods
+	static int lua_actor_get_component(lua_State* L);
+	static int lua_actor_get_name(lua_State* L);
+	static int lua_actor_get_id(lua_State* L);
+	static int lua_actor_get_transform(lua_State* L);
+
+	//Transform methods: GetPositionXY() -> x, y and SetPositionXY(x, y), the position without a vec2 userdata
+	static int lua_transform_get_position_xy(lua_State* L);
+	static int lua_transform_set_position_xy(lua_State* L);
+};
+
+#endif
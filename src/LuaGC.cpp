@@ -0,0 +1,116 @@
+#include "LuaGC.h"
+
+#include "SDL2/SDL.h"
+
+using std::string;
+
+void LuaGC::attach(lua_State* state)
+{
+	L = state;
+
+	if (generational_mode) lua_gc(L, LUA_GCGEN, 0, 0);
+	else lua_gc(L, LUA_GCINC, 0, 0, STEP_SIZE_LOG2);
+
+	managed = !generational_mode && step_budget_us > 0;
+	if (managed) lua_gc(L, LUA_GCSTOP);
+
+	in_cycle = false;
+	fallen_back = false;
+	threshold_bytes = static_cast<size_t>(heap_bytes() * PAUSE);
+}
+
+void LuaGC::step()
+{
+	frame_ms = 0.0;
+	if (!managed) return;
+
+	size_t heap = heap_bytes();
+	if (!in_cycle && heap < threshold_bytes) return;
+	in_cycle = true;
+
+	//a single step is small (a few KB of marking or sweeping) except for the atomic phase, which cannot be split
+	double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+	uint64_t begin = SDL_GetPerformanceCounter();
+	uint64_t budget = static_cast<uint64_t>(step_budget_us * freq / 1000000.0);
+	do {
+		++steps;
+		if (lua_gc(L, LUA_GCSTEP, 0)) {
+			++cycles;
+			cycle_finished();
+			break;
+		}
+	} while (SDL_GetPerformanceCounter() - begin < budget);
+
+	frame_ms = (SDL_GetPerformanceCounter() - begin) * 1000.0 / freq;
+	total_ms += frame_ms;
+	if (frame_ms > max_frame_ms) max_frame_ms = frame_ms;
+
+	//scripts allocate faster than the budget lets us collect: hand the collector back to lua until a cycle finishes
+	if (in_cycle && !fallen_back && heap_bytes() > threshold_bytes * FALLBACK) {
+		lua_gc(L, LUA_GCRESTART);
+		fallen_back = true;
+		++fallbacks;
+	}
+}
+
+void LuaGC::full_collect()
+{
+	if (L == nullptr) return;
+
+	uint64_t begin = SDL_GetPerformanceCounter();
+	lua_gc(L, LUA_GCCOLLECT);
+	double ms = (SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	frame_ms += ms;
+	total_ms += ms;
+	if (frame_ms > max_frame_ms) max_frame_ms = frame_ms;
+	++full_collections;
+
+	if (managed) cycle_finished();
+}
+
+void LuaGC::collect_stats(std::vector<std::pair<string, double>>& out)
+{
+	out.emplace_back("gc_generational", generational_mode ? 1.0 : 0.0);
+	out.emplace_back("gc_heap_kb", L == nullptr ? 0.0 : heap_bytes() / 1024.0);
+	out.emplace_back("gc_threshold_kb", managed ? threshold_bytes / 1024.0 : 0.0);
+	out.emplace_back("gc_frame_ms", frame_ms);
+	out.emplace_back("gc_max_frame_ms", max_frame_ms);
+	out.emplace_back("gc_total_ms", total_ms);
+	out.emplace_back("gc_steps", static_cast<double>(steps));
+	out.emplace_back("gc_cycles", static_cast<double>(cycles));
+	out.emplace_back("gc_full_collections", static_cast<double>(full_collections));
+	out.emplace_back("gc_fallbacks", static_cast<double>(fallbacks));
+}
+
+int LuaGC::lua_get_stats(lua_State* state)
+{
+	std::vector<std::pair<string, double>> stats;
+	collect_stats(stats);
+
+	lua_createtable(state, 0, static_cast<int>(stats.size()));
+	for (const auto& stat : stats) {
+		lua_pushnumber(state, stat.second);
+		lua_setfield(state, -2, stat.first.c_str());
+	}
+	return 1;
+}
+
+
+/* ------------------------ private ------------------------ */
+
+size_t LuaGC::heap_bytes()
+{
+	return static_cast<size_t>(lua_gc(L, LUA_GCCOUNT)) * 1024 + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB));
+}
+
+void LuaGC::cycle_finished()
+{
+	in_cycle = false;
+	threshold_bytes = static_cast<size_t>(heap_bytes() * PAUSE);
+
+	if (fallen_back) {
+		lua_gc(L, LUA_GCSTOP);
+		fallen_back = false;
+	}
+}
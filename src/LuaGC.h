@@ -0,0 +1,64 @@
+#ifndef LUA_GC_H
+#define LUA_GC_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+//engine-driven garbage collection for the main lua state. incremental mode stops lua's own collector and runs
+//it in small steps after each present, up to a per-frame time budget, so the mark / atomic work lands in frame slack
+//instead of in whichever script call happened to allocate. generational mode leaves lua's (short) young collections
+//automatic. either way a scene load ends with a full collection
+class LuaGC
+{
+public:
+	//game.config "gc_mode" ("incremental" or "generational") and "gc_step_budget_us" (0 = lua collects on its own);
+	//call before attach
+	static void set_mode(bool generational) { generational_mode = generational; }
+	static void set_step_budget(int us) { step_budget_us = us < 0 ? 0 : us; }
+
+	//applies the mode to state (ComponentDB::init)
+	static void attach(lua_State* state);
+
+	//steps the collector until the budget is spent or a cycle finishes (after Renderer::disp)
+	static void step();
+
+	//finishes any cycle in progress and collects everything unreachable (scene load)
+	static void full_collect();
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+	//lua: Debug.GetGCStats() -> table of the gc_ numbers from collect_stats
+	static int lua_get_stats(lua_State* L);
+
+private:
+	static constexpr double PAUSE = 2.0;		//start a cycle once the heap doubles the size left by the last one (lua's default)
+	static constexpr int STEP_SIZE_LOG2 = 10;	//1KB steps (lua's default is 8KB) so the budget check runs often
+	static constexpr double FALLBACK = 2.0;		//heap this many times over the threshold: budget is too small, let lua collect
+
+	static inline lua_State* L = nullptr;
+	static inline bool generational_mode = false;
+	static inline int step_budget_us = 1000;
+	static inline bool managed = false;		//collector stopped, stepped by step()
+
+	static inline bool in_cycle = false;
+	static inline bool fallen_back = false;
+	static inline size_t threshold_bytes = 0;
+
+	static inline double frame_ms = 0.0;		//explicit stepping (and full collections) during the last step() / full_collect()
+	static inline double max_frame_ms = 0.0;
+	static inline double total_ms = 0.0;
+	static inline size_t steps = 0;
+	static inline size_t cycles = 0;			//finished by step()
+	static inline size_t full_collections = 0;
+	static inline size_t fallbacks = 0;
+
+	static size_t heap_bytes();
+	static void cycle_finished();
+};
+
+#endif
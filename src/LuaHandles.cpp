@@ -0,0 +1,89 @@
+#include "LuaHandles.h"
+
+#include "Actor.h"
+
+void LuaHandles::init(lua_State* state)
+{
+	L = state;
+	add_cache(&cache_key<Actor>);
+	add_cache(&cache_key<Transform>);
+
+	//every access errors; LuaBridge type checks reject it as an Actor / Transform since the metatable no longer matches
+	lua_newtable(L);
+	lua_pushstring(L, "destroyed object");
+	lua_setfield(L, -2, "__name");
+	lua_pushcfunction(L, &LuaHandles::lua_destroyed_index);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, &LuaHandles::lua_destroyed_index);
+	lua_setfield(L, -2, "__newindex");
+	lua_pushcfunction(L, &LuaHandles::lua_destroyed_tostring);
+	lua_setfield(L, -2, "__tostring");
+	lua_pushstring(L, "destroyed object");
+	lua_setfield(L, -2, "__metatable");
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &destroyed_key);
+}
+
+
+/* ------------------------ private ------------------------ */
+
+bool LuaHandles::push_cached(lua_State* state, const void* cache, const void* p)
+{
+	if (lua_rawgetp(state, LUA_REGISTRYINDEX, cache) != LUA_TTABLE) {
+		lua_pop(state, 1);
+		return false;
+	}
+	if (lua_rawgetp(state, -1, p) != LUA_TUSERDATA) {
+		lua_pop(state, 2);
+		return false;
+	}
+	lua_remove(state, -2);
+	return true;
+}
+
+void LuaHandles::remember(lua_State* state, const void* cache, const void* p)
+{
+	if (lua_rawgetp(state, LUA_REGISTRYINDEX, cache) != LUA_TTABLE) {
+		lua_pop(state, 1);
+		return;
+	}
+	lua_pushvalue(state, -2);
+	lua_rawsetp(state, -2, p);
+	lua_pop(state, 1);
+}
+
+void LuaHandles::release(const void* cache, const void* p)
+{
+	lua_rawgetp(L, LUA_REGISTRYINDEX, cache);
+	if (lua_rawgetp(L, -1, p) == LUA_TUSERDATA) {
+		lua_rawgetp(L, LUA_REGISTRYINDEX, &destroyed_key);
+		lua_setmetatable(L, -2);
+
+		lua_pushnil(L);
+		lua_rawsetp(L, -3, p);
+		++released;
+	}
+	lua_pop(L, 2);
+}
+
+void LuaHandles::add_cache(const void* cache)
+{
+	//weak values: a handle no script holds is collected and the next push makes a new one
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushstring(L, "v");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, cache);
+}
+
+int LuaHandles::lua_destroyed_index(lua_State* state)
+{
+	const char* key = lua_type(state, 2) == LUA_TSTRING ? lua_tostring(state, 2) : "?";
+	return luaL_error(state, "attempt to use '%s' of an actor (or its Transform) that was destroyed", key);
+}
+
+int LuaHandles::lua_destroyed_tostring(lua_State* state)
+{
+	lua_pushstring(state, "destroyed object");
+	return 1;
+}
@@ -0,0 +1,99 @@
+#ifndef LUA_HANDLES_H
+#define LUA_HANDLES_H
+
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+class Actor;
+class Transform;
+
+//actors and transforms reach lua as one cached userdata per object (a weak registry table maps the object to it)
+//instead of a fresh one per push. when SceneDB frees or pools an actor, release() finds that userdata and swaps its
+//metatable for a "destroyed" one, so a script still holding it gets an error instead of freed memory or a recycled actor
+class LuaHandles
+{
+public:
+	//creates the caches and the destroyed metatable (ComponentDB::init)
+	static void init(lua_State* state);
+	static void deinit() { L = nullptr; }
+
+	//pushes the cached handle of p (nil for nullptr); states without caches (shard workers) get a plain userdata
+	template<class T>
+	static void push(lua_State* state, T* p) {
+		if (p == nullptr) {
+			lua_pushnil(state);
+			return;
+		}
+		if (push_cached(state, &cache_key<T>, p)) return;
+
+		luabridge::detail::UserdataPtr::push(state, p);
+		remember(state, &cache_key<T>, p);
+	}
+
+	//cuts off the handle of p, if lua holds one
+	template<class T>
+	static void release(const T* p) {
+		if (L != nullptr) release(&cache_key<T>, p);
+	}
+
+	static size_t get_released() { return released; }
+
+private:
+	static inline lua_State* L = nullptr;
+	static inline size_t released = 0;
+
+	//address is the registry key of the cache for T
+	template<class T>
+	static inline const char cache_key = 0;
+	static inline const char destroyed_key = 0;
+
+	//pushes the cached userdata and returns true, or pushes nothing and returns false
+	static bool push_cached(lua_State* state, const void* cache, const void* p);
+	//caches the userdata on top of the stack (left there)
+	static void remember(lua_State* state, const void* cache, const void* p);
+	static void release(const void* cache, const void* p);
+
+	static void add_cache(const void* cache);
+	static int lua_destroyed_index(lua_State* state);
+	static int lua_destroyed_tostring(lua_State* state);
+};
+
+//route every LuaBridge push of an Actor / Transform pointer or reference through the cache; gets are unchanged
+#define LUA_HANDLE_STACK(T) \
+	template<> struct StackOpSelector<T*, true> { \
+		typedef T* ReturnType; \
+		static void push(lua_State* L, T* value) { LuaHandles::push(L, value); } \
+		static T* get(lua_State* L, int index) { return Userdata::get<T>(L, index, false); } \
+		static bool isInstance(lua_State* L, int index) { return Userdata::isInstance<T>(L, index); } \
+	}; \
+	template<> struct StackOpSelector<const T*, true> { \
+		typedef const T* ReturnType; \
+		static void push(lua_State* L, const T* value) { LuaHandles::push(L, const_cast<T*>(value)); } \
+		static const T* get(lua_State* L, int index) { return Userdata::get<T>(L, index, true); } \
+		static bool isInstance(lua_State* L, int index) { return Userdata::isInstance<T>(L, index); } \
+	}; \
+	template<> struct StackOpSelector<T&, true> { \
+		typedef RefStackHelper<T, false> Helper; \
+		typedef Helper::return_type ReturnType; \
+		static void push(lua_State* L, T& value) { LuaHandles::push(L, &value); } \
+		static ReturnType get(lua_State* L, int index) { return Helper::get(L, index); } \
+		static bool isInstance(lua_State* L, int index) { return Userdata::isInstance<T>(L, index); } \
+	}; \
+	template<> struct StackOpSelector<const T&, true> { \
+		typedef RefStackHelper<T, false> Helper; \
+		typedef Helper::return_type ReturnType; \
+		static void push(lua_State* L, const T& value) { LuaHandles::push(L, const_cast<T*>(&value)); } \
+		static ReturnType get(lua_State* L, int index) { return Helper::get(L, index); } \
+		static bool isInstance(lua_State* L, int index) { return Userdata::isInstance<T>(L, index); } \
+	};
+
+namespace luabridge {
+namespace detail {
+LUA_HANDLE_STACK(Actor)
+LUA_HANDLE_STACK(Transform)
+}
+}
+
+#undef LUA_HANDLE_STACK
+
+#endif
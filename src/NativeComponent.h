@@ -0,0 +1,57 @@
+#ifndef NATIVE_COMPONENT_H
+#define NATIVE_COMPONENT_H
+
+/*
+ * Interface for component types written in C++.
+ *
+ * Compiled in: call NativeComponentDB::register_type(desc) before ComponentDB::init.
+ * Plugin: build a shared library against the engine headers, put it in resources_internal/component_types/
+ * and export both functions below. The engine calls register_native_components once at startup.
+ *
+ *	extern "C" int native_component_api_version() { return NATIVE_COMPONENT_API_VERSION; }
+ *	extern "C" void register_native_components(void (*register_type)(const NativeComponentDesc& desc)) { ... }
+ *
+ * Instances are attached from json or AddComponent like lua components, and scripts see them as tables
+ * whose declared fields read and write the native data.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+class Actor;
+
+inline const int NATIVE_COMPONENT_API_VERSION = 1;
+
+#ifdef _WIN32
+#define NATIVE_COMPONENT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define NATIVE_COMPONENT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+struct NativeComponentDesc
+{
+	enum FieldKind : uint8_t { FIELD_FLOAT, FIELD_INT, FIELD_BOOL };
+
+	//a member of the instance data that scripts and json can set
+	struct Field {
+		const char* name;
+		FieldKind kind;
+		size_t offset;			//offsetof(your_struct, member)
+		double default_value;
+	};
+
+	const char* name = nullptr;		//component type name used in json and AddComponent
+
+	//instance data is zeroed, then field defaults are applied; it is moved with memcpy, so keep it trivially copyable
+	size_t data_size = 0;
+	const Field* fields = nullptr;
+	size_t field_count = 0;
+
+	//all optional; run in one batch per type each frame, for enabled instances on started, awake actors
+	void (*on_start)(void* data, Actor* actor) = nullptr;
+	void (*on_update)(void* data, Actor* actor, float dt) = nullptr;
+	void (*on_late_update)(void* data, Actor* actor) = nullptr;
+	void (*on_destroy)(void* data, Actor* actor) = nullptr;		//instance leaving the scene
+};
+
+#endif
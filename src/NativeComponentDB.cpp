@@ -0,0 +1,291 @@
+#include "NativeComponentDB.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "Consts.h"
+
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void NativeComponentDB::register_type(const NativeComponentDesc& desc)
+{
+	if (desc.name == nullptr || (desc.field_count > 0 && desc.fields == nullptr)) {
+		cout << "error: native component registered without a name or fields";
+		exit(0);
+	}
+
+	pending.push_back(desc);
+}
+
+void NativeComponentDB::add_component_types(lua_State* state)
+{
+	register_builtin_types();
+	load_plugins();
+
+	for (const NativeComponentDesc& desc : pending) {
+		add_type(state, desc);
+	}
+	pending.clear();
+}
+
+void NativeComponentDB::update(float dt)
+{
+	for (pool& p : pools) {
+		if (p.desc.on_start == nullptr && p.desc.on_update == nullptr) continue;
+
+		//rows added by callbacks wait for next frame; data may move if a callback attaches to this pool, so re-fetch per row
+		size_t rows = p.actor.size();
+		for (uint32_t row = 0; row < rows && row < p.actor.size(); ++row) {
+			if (!prepare_row(p, row) || p.desc.on_update == nullptr) continue;
+			p.desc.on_update(p.row_data(row), p.actor[row], dt);
+		}
+	}
+}
+
+void NativeComponentDB::late_update()
+{
+	for (pool& p : pools) {
+		if (p.desc.on_late_update == nullptr) continue;
+
+		size_t rows = p.actor.size();
+		for (uint32_t row = 0; row < rows && row < p.actor.size(); ++row) {
+			if (!prepare_row(p, row)) continue;
+			p.desc.on_late_update(p.row_data(row), p.actor[row]);
+		}
+	}
+}
+
+void NativeComponentDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	size_t instances = 0;
+	for (const pool& p : pools) {
+		instances += p.actor.size();
+	}
+	out.emplace_back("native_types", static_cast<double>(pools.size()));
+	out.emplace_back("native_instances", static_cast<double>(instances));
+	out.emplace_back("native_plugins", static_cast<double>(plugins.size()));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+namespace {
+	//moves the actor's transform each frame without a trip through lua
+	struct mover_data {
+		float velocity_x;
+		float velocity_y;
+		float angular_velocity;		//degrees per second
+	};
+
+	const NativeComponentDesc::Field MOVER_FIELDS[] = {
+		{ "velocity_x", NativeComponentDesc::FIELD_FLOAT, offsetof(mover_data, velocity_x), 0.0 },
+		{ "velocity_y", NativeComponentDesc::FIELD_FLOAT, offsetof(mover_data, velocity_y), 0.0 },
+		{ "angular_velocity", NativeComponentDesc::FIELD_FLOAT, offsetof(mover_data, angular_velocity), 0.0 },
+	};
+
+	void mover_update(void* data, Actor* actor, float dt)
+	{
+		const mover_data* m = static_cast<const mover_data*>(data);
+		Transform& t = actor->get_transform();
+		t.position += glm::vec2(m->velocity_x, m->velocity_y) * dt;
+		t.rotation_deg += m->angular_velocity * dt;
+	}
+}
+
+void NativeComponentDB::register_builtin_types()
+{
+	NativeComponentDesc mover;
+	mover.name = "Mover";
+	mover.data_size = sizeof(mover_data);
+	mover.fields = MOVER_FIELDS;
+	mover.field_count = sizeof(MOVER_FIELDS) / sizeof(MOVER_FIELDS[0]);
+	mover.on_update = &mover_update;
+	register_type(mover);
+}
+
+void NativeComponentDB::load_plugins()
+{
+	if (!std::filesystem::exists(ENGINE_COMPONENT_FOLDER_PATH)) return;
+
+#ifdef _WIN32
+	const std::string extension = ".dll";
+#elif __APPLE__
+	const std::string extension = ".dylib";
+#else
+	const std::string extension = ".so";
+#endif
+
+	typedef int (*version_fn)();
+	typedef void (*register_fn)(void (*)(const NativeComponentDesc&));
+
+	for (const auto& entry : std::filesystem::directory_iterator(ENGINE_COMPONENT_FOLDER_PATH)) {
+		if (entry.path().extension().string() != extension) continue;
+
+		std::string path = entry.path().string();
+
+#ifdef _WIN32
+		HMODULE lib = LoadLibraryA(path.c_str());
+		if (lib == nullptr) {
+			cout << "error: failed to load component plugin " << path;
+			exit(0);
+		}
+		version_fn get_version = reinterpret_cast<version_fn>(GetProcAddress(lib, "native_component_api_version"));
+		register_fn register_components = reinterpret_cast<register_fn>(GetProcAddress(lib, "register_native_components"));
+#else
+		void* lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (lib == nullptr) {
+			cout << "error: failed to load component plugin " << path << ": " << dlerror();
+			exit(0);
+		}
+		version_fn get_version = reinterpret_cast<version_fn>(dlsym(lib, "native_component_api_version"));
+		register_fn register_components = reinterpret_cast<register_fn>(dlsym(lib, "register_native_components"));
+#endif
+
+		if (get_version == nullptr || register_components == nullptr) {
+			cout << "error: component plugin " << path << " does not export native_component_api_version and register_native_components";
+			exit(0);
+		}
+
+		if (get_version() != NATIVE_COMPONENT_API_VERSION) {
+			cout << "error: component plugin " << path << " was built for api version " << get_version() << ", engine is " << NATIVE_COMPONENT_API_VERSION;
+			exit(0);
+		}
+
+		plugins.push_back(reinterpret_cast<void*>(lib));
+		register_components(&NativeComponentDB::register_type);
+	}
+}
+
+void NativeComponentDB::add_type(lua_State* state, const NativeComponentDesc& desc)
+{
+	pools.emplace_back();
+	pool& p = pools.back();
+	p.desc = desc;
+	p.stride = (desc.data_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	ComponentDB::native_type type;
+	type.attach = [&p](Actor* a, LuaRef& comp) { return attach(p, a, comp); };
+	type.detach = [&p](uint32_t handle) { detach(p, handle); };
+
+	LuaRef prototype = luabridge::newTable(state);
+	prototype["enabled"] = true;
+
+	for (size_t i = 0; i < desc.field_count; ++i) {
+		const NativeComponentDesc::Field field = desc.fields[i];
+
+		if (field.kind == NativeComponentDesc::FIELD_BOOL) prototype[field.name] = field.default_value != 0.0;
+		else if (field.kind == NativeComponentDesc::FIELD_INT) prototype[field.name] = static_cast<int>(field.default_value);
+		else prototype[field.name] = field.default_value;
+
+		ComponentDB::native_field accessor;
+		accessor.get = [&p, field](lua_State* L, uint32_t handle) {
+			unsigned char* at = p.row_data(p.index.row_of(handle)) + field.offset;
+			if (field.kind == NativeComponentDesc::FIELD_FLOAT) lua_pushnumber(L, *reinterpret_cast<float*>(at));
+			else if (field.kind == NativeComponentDesc::FIELD_INT) lua_pushinteger(L, *reinterpret_cast<int32_t*>(at));
+			else lua_pushboolean(L, *reinterpret_cast<bool*>(at));
+		};
+		accessor.set = [&p, field](lua_State* L, uint32_t handle, int idx) {
+			unsigned char* at = p.row_data(p.index.row_of(handle)) + field.offset;
+			if (field.kind == NativeComponentDesc::FIELD_FLOAT) *reinterpret_cast<float*>(at) = static_cast<float>(luaL_checknumber(L, idx));
+			else if (field.kind == NativeComponentDesc::FIELD_INT) *reinterpret_cast<int32_t*>(at) = static_cast<int32_t>(luaL_checknumber(L, idx));
+			else *reinterpret_cast<bool*>(at) = lua_toboolean(L, idx) != 0;
+		};
+		type.fields.emplace_back(field.name, accessor);
+	}
+
+	ComponentDB::native_field enabled;
+	enabled.get = [&p](lua_State* L, uint32_t handle) { lua_pushboolean(L, p.enabled[p.index.row_of(handle)]); };
+	enabled.set = [&p](lua_State* L, uint32_t handle, int idx) { p.enabled[p.index.row_of(handle)] = lua_toboolean(L, idx) ? 1 : 0; };
+	type.fields.emplace_back("enabled", enabled);
+
+	ComponentDB::register_native_type(desc.name, prototype, type);
+}
+
+uint32_t NativeComponentDB::attach(pool& p, Actor* a, luabridge::LuaRef& comp)
+{
+	uint32_t handle;
+	if (!p.free_handles.empty()) {
+		handle = p.free_handles.back();
+		p.free_handles.pop_back();
+	}
+	else {
+		handle = p.next_handle++;
+	}
+
+	uint32_t row = p.index.add(handle);
+	p.data.resize(p.data.size() + p.stride, 0);
+	p.actor.push_back(a);
+	p.started.push_back(0);
+
+	LuaRef enabled = comp["enabled"];
+	p.enabled.push_back(enabled.isBool() ? enabled.cast<bool>() : 1);
+
+	//json / template values (or the prototype's defaults) become the initial data
+	unsigned char* data = p.row_data(row);
+	for (size_t i = 0; i < p.desc.field_count; ++i) {
+		const NativeComponentDesc::Field& field = p.desc.fields[i];
+		LuaRef value = comp[field.name];
+		unsigned char* at = data + field.offset;
+
+		if (field.kind == NativeComponentDesc::FIELD_FLOAT)
+			*reinterpret_cast<float*>(at) = value.isNumber() ? value.cast<float>() : static_cast<float>(field.default_value);
+		else if (field.kind == NativeComponentDesc::FIELD_INT)
+			*reinterpret_cast<int32_t*>(at) = value.isNumber() ? value.cast<int32_t>() : static_cast<int32_t>(field.default_value);
+		else
+			*reinterpret_cast<bool*>(at) = value.isBool() ? value.cast<bool>() : field.default_value != 0.0;
+	}
+
+	return handle;
+}
+
+void NativeComponentDB::detach(pool& p, uint32_t handle)
+{
+	uint32_t row = p.index.row_of(handle);
+	if (p.desc.on_destroy != nullptr)
+		p.desc.on_destroy(p.row_data(row), p.actor[row]);
+
+	//same swap as DenseIndex::remove, applied to the byte rows
+	uint32_t last = static_cast<uint32_t>(p.actor.size() - 1);
+	if (row != last)
+		std::memcpy(p.row_data(row), p.row_data(last), p.stride);
+	p.data.resize(p.data.size() - p.stride);
+
+	p.index.remove(handle);
+	swap_remove(p.actor, row);
+	swap_remove(p.enabled, row);
+	swap_remove(p.started, row);
+
+	p.free_handles.push_back(handle);
+}
+
+bool NativeComponentDB::prepare_row(pool& p, uint32_t row)
+{
+	Actor* a = p.actor[row];
+	if (!p.enabled[row] || !a->is_active() || !a->has_started() || a->activation.asleep)
+		return false;
+
+	if (!p.started[row]) {
+		p.started[row] = 1;
+		if (p.desc.on_start != nullptr) {
+			p.desc.on_start(p.row_data(row), a);
+
+			//OnStart may have detached this row (or others) and moved a different instance here
+			if (row >= p.actor.size() || p.actor[row] != a || !p.enabled[row]) return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,64 @@
+#ifndef NATIVE_COMPONENT_DB_H
+#define NATIVE_COMPONENT_DB_H
+
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <cstdint>
+
+#include "NativeComponent.h"
+#include "ComponentStore.h"
+
+//component types implemented in C++ (compiled in or loaded from plugins), stored in one packed pool per type
+class NativeComponentDB
+{
+public:
+	//queues desc for registration when ComponentDB initializes; name and fields must stay valid for the program's lifetime
+	static void register_type(const NativeComponentDesc& desc);
+
+	//registers the built in types, loads plugins from ENGINE_COMPONENT_FOLDER_PATH, then hands every queued type to ComponentDB
+	static void add_component_types(lua_State* state);
+
+	//runs OnStart (first time) and OnUpdate for every type, pool by pool
+	static void update(float dt);
+	static void late_update();
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	struct pool {
+		NativeComponentDesc desc;
+		size_t stride = 0;						//data_size rounded up to max_align_t
+
+		DenseIndex index;						//handle -> row
+		std::vector<uint32_t> free_handles;
+		uint32_t next_handle = 0;
+
+		std::vector<unsigned char> data;		//row * stride
+		std::vector<Actor*> actor;
+		std::vector<uint8_t> enabled;
+		std::vector<uint8_t> started;
+
+		unsigned char* row_data(uint32_t row) { return data.data() + row * stride; }
+	};
+
+	static inline std::vector<NativeComponentDesc> pending;
+	static inline std::deque<pool> pools;		//deque so pools stay put for the closures ComponentDB holds
+	static inline std::vector<void*> plugins;	//library handles, kept open for the life of the program
+
+	static void register_builtin_types();
+	static void load_plugins();
+	static void add_type(lua_State* state, const NativeComponentDesc& desc);
+
+	static uint32_t attach(pool& p, Actor* a, luabridge::LuaRef& comp);
+	static void detach(pool& p, uint32_t handle);
+
+	//true if the row should run this frame; runs OnStart the first time
+	static bool prepare_row(pool& p, uint32_t row);
+};
+
+#endif
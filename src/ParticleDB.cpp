@@ -0,0 +1,356 @@
+#include "ParticleDB.h"
+
+#include "Actor.h"
+#include "ImageDB.h"
+#include "Interner.h"
+#include "Renderer.h"
+#include "ComponentDB.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+const ParticleDB::setting_info ParticleDB::SETTINGS[] = {
+	{ "emission_rate", offsetof(settings, emission_rate), 10.f },
+	{ "max_particles", offsetof(settings, max_particles), 256.f },
+	{ "lifetime_min", offsetof(settings, lifetime_min), 1.f },
+	{ "lifetime_max", offsetof(settings, lifetime_max), 1.f },
+	{ "speed_min", offsetof(settings, speed_min), 1.f },
+	{ "speed_max", offsetof(settings, speed_max), 2.f },
+	{ "angle_min", offsetof(settings, angle_min), 0.f },
+	{ "angle_max", offsetof(settings, angle_max), 360.f },
+	{ "size_start", offsetof(settings, size_start), 0.1f },
+	{ "size_end", offsetof(settings, size_end), 0.1f },
+	{ "gravity_x", offsetof(settings, gravity_x), 0.f },
+	{ "gravity_y", offsetof(settings, gravity_y), 0.f },
+	{ "drag", offsetof(settings, drag), 0.f },
+	{ "r", offsetof(settings, r), 255.f },
+	{ "g", offsetof(settings, g), 255.f },
+	{ "b", offsetof(settings, b), 255.f },
+	{ "a", offsetof(settings, a), 255.f },
+	{ "end_r", offsetof(settings, end_r), 255.f },
+	{ "end_g", offsetof(settings, end_g), 255.f },
+	{ "end_b", offsetof(settings, end_b), 255.f },
+	{ "end_a", offsetof(settings, end_a), 0.f },
+	{ "sorting_order", offsetof(settings, sorting_order), 0.f },
+};
+const size_t ParticleDB::SETTING_COUNT = sizeof(SETTINGS) / sizeof(SETTINGS[0]);
+
+namespace {
+	template<typename S>
+	float& setting_at(S& s, size_t offset) { return *reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(&s) + offset); }
+
+	uint8_t to_channel(float v) { return static_cast<uint8_t>(std::clamp(v, 0.f, 255.f)); }
+}
+
+void ParticleDB::add_component_types(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Particles")
+		.addFunction("Burst", &ParticleDB::burst)
+		.addFunction("Clear", &ParticleDB::clear)
+		.endNamespace();
+
+	LuaRef particles = luabridge::getGlobal(state, "Particles");
+	LuaRef burst_function = particles["Burst"];
+	LuaRef clear_function = particles["Clear"];
+
+	ComponentDB::native_type emitter_type;
+	emitter_type.attach = &ParticleDB::attach;
+	emitter_type.detach = &ParticleDB::detach;
+
+	LuaRef emitter_table = luabridge::newTable(state);
+
+	for (size_t i = 0; i < SETTING_COUNT; ++i) {
+		size_t offset = SETTINGS[i].offset;
+		emitter_table[SETTINGS[i].name] = SETTINGS[i].default_value;
+
+		ComponentDB::native_field field;
+		field.get = [offset](lua_State* L, uint32_t h) { lua_pushnumber(L, setting_at(emitters[index.row_of(h)].s, offset)); };
+		field.set = [offset](lua_State* L, uint32_t h, int idx) { setting_at(emitters[index.row_of(h)].s, offset) = static_cast<float>(luaL_checknumber(L, idx)); };
+		emitter_type.fields.emplace_back(SETTINGS[i].name, field);
+	}
+
+	emitter_type.fields.push_back({ "image", {
+		[](lua_State* L, uint32_t h) { lua_pushstring(L, Interner::get_string(emitters[index.row_of(h)].image).c_str()); },
+		[](lua_State* L, uint32_t h, int idx) {
+			emitter& e = emitters[index.row_of(h)];
+			e.image = Interner::get_id(luaL_checkstring(L, idx));
+			e.tex_loaded = false;
+		} } });
+	emitter_type.fields.push_back({ "emitting", {
+		[](lua_State* L, uint32_t h) { lua_pushboolean(L, emitters[index.row_of(h)].emitting); },
+		[](lua_State* L, uint32_t h, int idx) { emitters[index.row_of(h)].emitting = lua_toboolean(L, idx) ? 1 : 0; } } });
+	emitter_type.fields.push_back({ "enabled", {
+		[](lua_State* L, uint32_t h) { lua_pushboolean(L, emitters[index.row_of(h)].enabled); },
+		[](lua_State* L, uint32_t h, int idx) { emitters[index.row_of(h)].enabled = lua_toboolean(L, idx) ? 1 : 0; } } });
+
+	emitter_table["image"] = std::string();
+	emitter_table["emitting"] = true;
+	emitter_table["enabled"] = true;
+	emitter_table["Burst"] = burst_function;
+	emitter_table["Clear"] = clear_function;
+	ComponentDB::register_native_type("ParticleEmitter", emitter_table, emitter_type);
+}
+
+void ParticleDB::update(float dt)
+{
+	live_particles = 0;
+
+	for (emitter& e : emitters) {
+		if (!e.enabled) continue;
+
+		const Actor* a = e.actor;
+		if (!a->is_active() || !a->has_started() || a->activation.asleep) continue;
+
+		if (!e.p.x.empty()) {
+			integrate(e.p, e.s, dt);
+			remove_dead(e.p);
+		}
+
+		if (e.emitting && e.s.emission_rate > 0.f) {
+			e.spawn_debt += e.s.emission_rate * dt;
+			size_t count = static_cast<size_t>(e.spawn_debt);
+			e.spawn_debt -= static_cast<float>(count);
+			spawn(e, count);
+		}
+
+		if (e.p.x.empty()) continue;
+
+		shade(e.p, e.s);
+		submit(e);
+		live_particles += e.p.x.size();
+	}
+}
+
+void ParticleDB::burst(const luabridge::LuaRef& comp, int count)
+{
+	uint32_t row = row_of(comp);
+	if (row == DenseIndex::NONE || count <= 0) return;
+
+	spawn(emitters[row], static_cast<size_t>(count));
+}
+
+void ParticleDB::clear(const luabridge::LuaRef& comp)
+{
+	uint32_t row = row_of(comp);
+	if (row == DenseIndex::NONE) return;
+
+	particle_columns& p = emitters[row].p;
+	p.x.clear();
+	p.y.clear();
+	p.vx.clear();
+	p.vy.clear();
+	p.t.clear();
+	p.rate.clear();
+}
+
+void ParticleDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("particle_emitters", static_cast<double>(emitters.size()));
+	out.emplace_back("particles", static_cast<double>(live_particles));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+uint32_t ParticleDB::attach(Actor* a, luabridge::LuaRef& comp)
+{
+	uint32_t handle;
+	if (!free_handles.empty()) {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+	else {
+		handle = next_handle++;
+	}
+
+	emitter e;
+	e.actor = a;
+	e.actor_slot = a->store_slot;
+
+	for (size_t i = 0; i < SETTING_COUNT; ++i) {
+		LuaRef v = comp[SETTINGS[i].name];
+		setting_at(e.s, SETTINGS[i].offset) = v.isNumber() ? v.cast<float>() : SETTINGS[i].default_value;
+	}
+
+	LuaRef image = comp["image"];
+	LuaRef emitting = comp["emitting"];
+	LuaRef enabled = comp["enabled"];
+	e.image = Interner::get_id(image.isString() ? image.tostring() : "");
+	e.emitting = emitting.isBool() ? emitting.cast<bool>() : 1;
+	e.enabled = enabled.isBool() ? enabled.cast<bool>() : 1;
+
+	index.add(handle);
+	emitters.push_back(std::move(e));
+	return handle;
+}
+
+void ParticleDB::detach(uint32_t handle)
+{
+	uint32_t row = index.remove(handle);
+	if (row != emitters.size() - 1)
+		emitters[row] = std::move(emitters.back());
+	emitters.pop_back();
+
+	free_handles.push_back(handle);
+}
+
+uint32_t ParticleDB::row_of(const luabridge::LuaRef& comp)
+{
+	LuaRef handle = comp["native_id"];
+	if (!handle.isNumber()) return DenseIndex::NONE;
+	return index.row_of(handle.cast<uint32_t>());
+}
+
+float ParticleDB::random(float lo, float hi)
+{
+	//xorshift32; particles only need cheap, not good, randomness
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return lo + (hi - lo) * (static_cast<float>(rng_state >> 8) * (1.f / 16777216.f));
+}
+
+void ParticleDB::spawn(emitter& e, size_t count)
+{
+	size_t max = static_cast<size_t>(std::max(e.s.max_particles, 0.f));
+	count = std::min(count, max - std::min(max, e.p.x.size()));
+	if (count == 0) return;
+
+	const ComponentStore::transform_columns& transforms = ComponentStore::get_transforms();
+	uint32_t row = ComponentStore::transform_row(e.actor_slot);
+	float x = transforms.x[row];
+	float y = transforms.y[row];
+
+	const float deg_to_rad = 3.14159265f / 180.f;
+	particle_columns& p = e.p;
+	for (size_t i = 0; i < count; ++i) {
+		float angle = random(e.s.angle_min, e.s.angle_max) * deg_to_rad;
+		float speed = random(e.s.speed_min, e.s.speed_max);
+		float lifetime = std::max(random(e.s.lifetime_min, e.s.lifetime_max), 0.001f);
+
+		p.x.push_back(x);
+		p.y.push_back(y);
+		p.vx.push_back(std::cos(angle) * speed);
+		p.vy.push_back(std::sin(angle) * speed);
+		p.t.push_back(0.f);
+		p.rate.push_back(1.f / lifetime);
+	}
+}
+
+void ParticleDB::integrate(particle_columns& p, const settings& s, float dt)
+{
+	size_t n = p.x.size();
+	size_t i = 0;
+
+	float damp = std::max(0.f, 1.f - s.drag * dt);
+	float gx = s.gravity_x * dt;
+	float gy = s.gravity_y * dt;
+
+#ifdef PARTICLES_SSE
+	__m128 v_dt = _mm_set1_ps(dt);
+	__m128 v_damp = _mm_set1_ps(damp);
+	__m128 v_gx = _mm_set1_ps(gx);
+	__m128 v_gy = _mm_set1_ps(gy);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&p.vx[i]), v_damp), v_gx);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&p.vy[i]), v_damp), v_gy);
+		_mm_storeu_ps(&p.vx[i], vx);
+		_mm_storeu_ps(&p.vy[i], vy);
+		_mm_storeu_ps(&p.x[i], _mm_add_ps(_mm_loadu_ps(&p.x[i]), _mm_mul_ps(vx, v_dt)));
+		_mm_storeu_ps(&p.y[i], _mm_add_ps(_mm_loadu_ps(&p.y[i]), _mm_mul_ps(vy, v_dt)));
+		_mm_storeu_ps(&p.t[i], _mm_add_ps(_mm_loadu_ps(&p.t[i]), _mm_mul_ps(_mm_loadu_ps(&p.rate[i]), v_dt)));
+	}
+#endif
+
+	for (; i < n; ++i) {
+		p.vx[i] = p.vx[i] * damp + gx;
+		p.vy[i] = p.vy[i] * damp + gy;
+		p.x[i] += p.vx[i] * dt;
+		p.y[i] += p.vy[i] * dt;
+		p.t[i] += p.rate[i] * dt;
+	}
+}
+
+void ParticleDB::shade(particle_columns& p, const settings& s)
+{
+	size_t n = p.x.size();
+	p.size.resize(n);
+	p.cr.resize(n);
+	p.cg.resize(n);
+	p.cb.resize(n);
+	p.ca.resize(n);
+
+	//start + (end - start) * t for size and each channel
+	const float start[5] = { s.size_start, s.r, s.g, s.b, s.a };
+	const float delta[5] = { s.size_end - s.size_start, s.end_r - s.r, s.end_g - s.g, s.end_b - s.b, s.end_a - s.a };
+	float* out[5] = { p.size.data(), p.cr.data(), p.cg.data(), p.cb.data(), p.ca.data() };
+
+	for (size_t c = 0; c < 5; ++c) {
+		size_t i = 0;
+#ifdef PARTICLES_SSE
+		__m128 v_start = _mm_set1_ps(start[c]);
+		__m128 v_delta = _mm_set1_ps(delta[c]);
+		for (; i + 4 <= n; i += 4) {
+			_mm_storeu_ps(out[c] + i, _mm_add_ps(v_start, _mm_mul_ps(_mm_loadu_ps(&p.t[i]), v_delta)));
+		}
+#endif
+		for (; i < n; ++i) {
+			out[c][i] = start[c] + p.t[i] * delta[c];
+		}
+	}
+}
+
+void ParticleDB::remove_dead(particle_columns& p)
+{
+	size_t i = 0;
+	while (i < p.t.size()) {
+		if (p.t[i] < 1.f) {
+			++i;
+			continue;
+		}
+
+		uint32_t row = static_cast<uint32_t>(i);
+		swap_remove(p.x, row);
+		swap_remove(p.y, row);
+		swap_remove(p.vx, row);
+		swap_remove(p.vy, row);
+		swap_remove(p.t, row);
+		swap_remove(p.rate, row);
+	}
+}
+
+void ParticleDB::submit(emitter& e)
+{
+	if (!e.tex_loaded) {
+		const std::string& image = Interner::get_string(e.image);
+		e.tex = image.empty() ? nullptr : ImageDB::get_image(image);
+		e.tex_loaded = true;
+	}
+
+	const particle_columns& p = e.p;
+	size_t n = p.x.size();
+	SDL_Vertex* v = Renderer::queue_quads(e.tex, n, static_cast<int>(e.s.sorting_order));
+
+	for (size_t i = 0; i < n; ++i, v += 4) {
+		float h = p.size[i] * 0.5f;
+		SDL_Color c = { to_channel(p.cr[i]), to_channel(p.cg[i]), to_channel(p.cb[i]), to_channel(p.ca[i]) };
+
+		v[0] = { { p.x[i] - h, p.y[i] - h }, c, { 0.f, 0.f } };
+		v[1] = { { p.x[i] + h, p.y[i] - h }, c, { 1.f, 0.f } };
+		v[2] = { { p.x[i] + h, p.y[i] + h }, c, { 1.f, 1.f } };
+		v[3] = { { p.x[i] - h, p.y[i] + h }, c, { 0.f, 1.f } };
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef PARTICLE_DB_H
+#define PARTICLE_DB_H
+
+#include "SDL2/SDL.h"
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include "ComponentStore.h"
+
+class Actor;
+
+//native ParticleEmitter component: particles live in per-emitter column arrays, are simulated in bulk
+//(SSE where available) and drawn as one geometry batch per emitter
+class ParticleDB
+{
+public:
+	//registers the ParticleEmitter component type (and the Particles namespace) with ComponentDB
+	static void add_component_types(lua_State* state);
+
+	//emits, simulates and queues every emitter; run after the final transform sync so particles spawn at final positions
+	static void update(float dt);
+
+	//lua: emitter:Burst(count) spawns count particles now, emitter:Clear() removes all live particles
+	static void burst(const luabridge::LuaRef& comp, int count);
+	static void clear(const luabridge::LuaRef& comp);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	//every numeric setting is a float so json, the prototype and the proxies can treat them alike
+	struct settings {
+		float emission_rate;		//particles per second while emitting
+		float max_particles;
+		float lifetime_min;			//seconds
+		float lifetime_max;
+		float speed_min;			//world units per second
+		float speed_max;
+		float angle_min;			//degrees, 0 is +x
+		float angle_max;
+		float size_start;			//world units, interpolated over the particle's life
+		float size_end;
+		float gravity_x;
+		float gravity_y;
+		float drag;					//fraction of velocity lost per second
+		float r, g, b, a;			//color at birth
+		float end_r, end_g, end_b, end_a;	//color at death
+		float sorting_order;
+	};
+
+	struct setting_info {
+		const char* name;
+		size_t offset;
+		float default_value;
+	};
+	static const setting_info SETTINGS[];
+	static const size_t SETTING_COUNT;
+
+	struct particle_columns {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> vx;
+		std::vector<float> vy;
+		std::vector<float> t;			//age / lifetime, dies at 1
+		std::vector<float> rate;		//1 / lifetime
+		std::vector<float> size;		//filled by shade() from t
+		std::vector<float> cr, cg, cb, ca;
+	};
+
+	struct emitter {
+		Actor* actor;
+		uint32_t actor_slot;
+		settings s;
+		uint32_t image;					//interned, empty name draws untextured quads
+		SDL_Texture* tex = nullptr;
+		bool tex_loaded = false;
+		uint8_t emitting = 1;
+		uint8_t enabled = 1;
+		float spawn_debt = 0.f;			//fractional particles carried to the next frame
+		particle_columns p;
+	};
+
+	static inline std::vector<uint32_t> free_handles;
+	static inline uint32_t next_handle = 0;
+	static inline DenseIndex index;
+	static inline std::vector<emitter> emitters;
+
+	static inline uint32_t rng_state = 0x9E3779B9u;
+	static inline size_t live_particles = 0;
+
+	static uint32_t attach(Actor* a, luabridge::LuaRef& comp);
+	static void detach(uint32_t handle);
+	static uint32_t row_of(const luabridge::LuaRef& comp);
+
+	static float random(float lo, float hi);
+	static void spawn(emitter& e, size_t count);
+
+	//kernels over the particle columns
+	static void integrate(particle_columns& p, const settings& s, float dt);
+	static void shade(particle_columns& p, const settings& s);
+	static void remove_dead(particle_columns& p);
+
+	static void submit(emitter& e);
+};
+
+#endif
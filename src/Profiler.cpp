@@ -0,0 +1,272 @@
+#include "Profiler.h"
+
+#include "SDL2/SDL.h"
+#include "LuaBridge/LuaBridge.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "Interner.h"
+#include "Consts.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <system_error>
+#include <cstdlib>
+
+using std::string;
+using std::cout;
+using std::endl;
+
+void Profiler::add_functions(lua_State* state)
+{
+	L = state;
+
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Debug")
+		.addCFunction("ProfileStart", &Profiler::lua_start)
+		.addCFunction("ProfileStop", &Profiler::lua_stop)
+		.addCFunction("ProfileWrite", &Profiler::lua_write)
+		.addCFunction("ProfileSummary", &Profiler::lua_summary)
+		.endNamespace();
+
+	if (start_on_init) {
+		start(sample_interval);
+		std::atexit(&Profiler::write_on_exit);
+	}
+}
+
+void Profiler::start(int sample_instructions)
+{
+	enabled = true;
+	sample_interval = sample_instructions < 0 ? 0 : sample_instructions;
+	window_start = SDL_GetPerformanceCounter();
+	frames_since_summary = 0;
+
+	//coroutines created from here on inherit the hook; ones already running are not sampled
+	if (sample_interval > 0) lua_sethook(L, &Profiler::hook, LUA_MASKCOUNT, sample_interval);
+	else lua_sethook(L, nullptr, 0, 0);
+}
+
+void Profiler::stop()
+{
+	enabled = false;
+	lua_sethook(L, nullptr, 0, 0);
+}
+
+bool Profiler::write_folded(const string& name)
+{
+	//error_code overload: this also runs from write_on_exit, where an exception would terminate
+	std::error_code ec;
+	std::filesystem::create_directories(PROFILE_FOLDER_PATH, ec);
+
+	double ticks_per_us = SDL_GetPerformanceFrequency() / 1000000.0;
+	std::ofstream time_file(PROFILE_FOLDER_PATH + name + "_time.folded");
+	std::ofstream alloc_file(PROFILE_FOLDER_PATH + name + "_alloc.folded");
+	if (!time_file || !alloc_file) {
+		cout << "error: failed to write profile " << PROFILE_FOLDER_PATH << name << endl;
+		return false;
+	}
+
+	for (const auto& entry : zones) {
+		string frame = zone_frame(entry.first);
+		uint64_t us = static_cast<uint64_t>(entry.second.self_ticks / ticks_per_us);
+		if (us > 0) time_file << frame << " " << us << "\n";
+		if (entry.second.self_bytes > 0) alloc_file << frame << " " << entry.second.self_bytes << "\n";
+	}
+
+	if (!samples.empty()) {
+		std::ofstream sample_file(PROFILE_FOLDER_PATH + name + "_samples.folded");
+		for (const auto& entry : samples) {
+			sample_file << entry.first << " " << entry.second << "\n";
+		}
+	}
+	return true;
+}
+
+void Profiler::end_frame()
+{
+	if (!enabled || summary_frames == 0 || ++frames_since_summary < summary_frames) return;
+
+	uint64_t now = SDL_GetPerformanceCounter();
+	print_summary(summary_top, (now - window_start) * 1000.0 / SDL_GetPerformanceFrequency());
+	window_start = now;
+	frames_since_summary = 0;
+}
+
+void Profiler::collect_stats(std::vector<std::pair<string, double>>& out)
+{
+	out.emplace_back("profiler_enabled", enabled ? 1.0 : 0.0);
+	out.emplace_back("profiler_zones", static_cast<double>(zones.size()));
+	out.emplace_back("profiler_ms", profiled_ticks * 1000.0 / SDL_GetPerformanceFrequency());
+	out.emplace_back("profiler_samples", static_cast<double>(sample_count));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+void Profiler::enter(uint32_t type_id, const char* callback, const Actor* actor)
+{
+	zone_key key = { type_id, callback, actor == nullptr ? -1 : actor->id };
+	auto it = zones.find(key);
+	if (it == zones.end()) {
+		it = zones.emplace(key, zone_totals()).first;
+		if (actor != nullptr) it->second.actor_name = actor->name;
+	}
+
+	//counters last, so the bookkeeping above is not charged to the zone
+	open_zones.push_back({ &it->second, key, 0, allocated_bytes(), 0, 0 });
+	open_zones.back().start_ticks = SDL_GetPerformanceCounter();
+}
+
+void Profiler::leave()
+{
+	if (open_zones.empty()) return;
+
+	uint64_t end_ticks = SDL_GetPerformanceCounter();
+	uint64_t end_bytes = allocated_bytes();
+
+	open_zone z = open_zones.back();
+	open_zones.pop_back();
+
+	uint64_t ticks = end_ticks - z.start_ticks;
+	uint64_t bytes = end_bytes - z.start_bytes;
+	uint64_t self_ticks = ticks > z.child_ticks ? ticks - z.child_ticks : 0;
+	uint64_t self_bytes = bytes > z.child_bytes ? bytes - z.child_bytes : 0;
+
+	zone_totals& t = *z.totals;
+	++t.calls;
+	++t.window_calls;
+	t.total_ticks += ticks;
+	t.self_ticks += self_ticks;
+	t.window_ticks += self_ticks;
+	t.self_bytes += self_bytes;
+	t.window_bytes += self_bytes;
+
+	if (open_zones.empty()) {
+		profiled_ticks += ticks;
+	}
+	else {
+		open_zones.back().child_ticks += ticks;
+		open_zones.back().child_bytes += bytes;
+	}
+}
+
+string Profiler::zone_frame(const zone_key& key)
+{
+	//';' separates frames and ' ' the count, so neither may appear inside one
+	auto clean = [](string s) {
+		std::replace(s.begin(), s.end(), ';', ':');
+		std::replace(s.begin(), s.end(), ' ', '_');
+		return s;
+	};
+
+	string frame = clean(Interner::get_string(key.type_id)) + ";" + key.callback;
+	if (key.actor_id >= 0) {
+		auto it = zones.find(key);
+		string actor_name = it == zones.end() ? "" : it->second.actor_name;
+		frame += ";" + clean(actor_name) + "#" + std::to_string(key.actor_id);
+	}
+	return frame;
+}
+
+void Profiler::hook(lua_State* state, lua_Debug* ar)
+{
+	if (ar->event != LUA_HOOKCOUNT) return;
+
+	//innermost lua frame last; the zone the sample landed in goes first
+	std::vector<string> frames;
+	lua_Debug info;
+	for (int level = 0; lua_getstack(state, level, &info); ++level) {
+		lua_getinfo(state, "Sn", &info);
+		string frame;
+		if (info.what[0] == 'C') frame = info.name != nullptr ? string("[C]") + info.name : "[C]";
+		else if (info.name != nullptr) frame = string(info.name) + "@" + info.short_src + ":" + std::to_string(info.linedefined);
+		else if (info.what[0] == 'm') frame = string("main@") + info.short_src;
+		else frame = string(info.short_src) + ":" + std::to_string(info.linedefined);
+		std::replace(frame.begin(), frame.end(), ';', ':');
+		std::replace(frame.begin(), frame.end(), ' ', '_');
+		frames.push_back(frame);
+	}
+
+	string stack = open_zones.empty() ? "(no zone)" : zone_frame(open_zones.back().key);
+	for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+		stack += ";" + *it;
+	}
+	++samples[stack];
+	++sample_count;
+}
+
+uint64_t Profiler::allocated_bytes()
+{
+	return ComponentDB::get_allocator().get_allocated_total();
+}
+
+void Profiler::print_summary(int top, double window_ms)
+{
+	std::vector<const std::pair<const zone_key, zone_totals>*> ranked;
+	uint64_t window_ticks = 0;
+	for (const auto& entry : zones) {
+		if (entry.second.window_calls == 0) continue;
+		ranked.push_back(&entry);
+		window_ticks += entry.second.window_ticks;
+	}
+
+	size_t shown = std::min(ranked.size(), static_cast<size_t>(top));
+	std::partial_sort(ranked.begin(), ranked.begin() + shown, ranked.end(), [](const auto* a, const auto* b) {
+		return a->second.window_ticks > b->second.window_ticks;
+	});
+
+	double ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+	double scripts_ms = window_ticks * ms_per_tick;
+	cout << "---- profiler: " << std::fixed << std::setprecision(2) << scripts_ms << " ms of " << window_ms << " ms in scripts ("
+		<< (window_ms > 0.0 ? 100.0 * scripts_ms / window_ms : 0.0) << "%) ----" << endl;
+	for (size_t i = 0; i < shown; ++i) {
+		const zone_totals& t = ranked[i]->second;
+		cout << std::setw(9) << t.window_ticks * ms_per_tick << " ms " << std::setw(7) << t.window_calls << " calls "
+			<< std::setw(9) << t.window_bytes / 1024.0 << " KB  " << zone_frame(ranked[i]->first) << endl;
+	}
+	cout.unsetf(std::ios::floatfield);
+	cout << std::setprecision(6);
+
+	for (auto& entry : zones) {
+		entry.second.window_calls = 0;
+		entry.second.window_ticks = 0;
+		entry.second.window_bytes = 0;
+	}
+}
+
+void Profiler::write_on_exit()
+{
+	write_folded("profile");
+}
+
+int Profiler::lua_start(lua_State* state)
+{
+	start(static_cast<int>(luaL_optinteger(state, 1, 0)));
+	return 0;
+}
+
+int Profiler::lua_stop(lua_State*)
+{
+	stop();
+	return 0;
+}
+
+int Profiler::lua_write(lua_State* state)
+{
+	if (!write_folded(luaL_optstring(state, 1, "profile")))
+		exit(0);
+	return 0;
+}
+
+int Profiler::lua_summary(lua_State* state)
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+	print_summary(static_cast<int>(luaL_optinteger(state, 1, summary_top)), (now - window_start) * 1000.0 / SDL_GetPerformanceFrequency());
+	window_start = now;
+	frames_since_summary = 0;
+	return 0;
+}
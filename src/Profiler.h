@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//attributes time and lua allocation bytes spent in script callbacks to (component type, callback, actor). zones wrap
+//each callback the engine makes (Actor lifecycle and collision functions, Event subscribers, Timers); with sampling on,
+//a count hook also records the lua call stack every n VM instructions. results go out as collapsed stacks
+//("a;b;c value" lines, the input format of flamegraph.pl / speedscope / inferno) and as a periodic top-n printout.
+//when off, a zone costs one branch
+class Profiler
+{
+public:
+	//opens a zone for one callback; nested zones (a callback that triggers another) get only their own (self) time
+	class zone {
+	public:
+		zone(uint32_t type_id, const char* callback, const Actor* actor) : open(enabled) {
+			if (open) enter(type_id, callback, actor);
+		}
+		~zone() { if (open) leave(); }
+		zone(const zone&) = delete;
+		zone& operator=(const zone&) = delete;
+	private:
+		bool open;
+	};
+
+	//game.config "profiler" turns zones on from the first frame and writes the "profile" files on quit;
+	//"profiler_sample_instructions" adds the hook (0 = zones only); "profiler_summary_frames" prints the top
+	//"profiler_summary_top" zones every that many frames. call before add_functions
+	static void set_options(bool on, int sample_instructions, int frames, int top) {
+		start_on_init = on;
+		sample_interval = sample_instructions < 0 ? 0 : sample_instructions;
+		summary_frames = frames < 0 ? 0 : frames;
+		summary_top = top < 1 ? 1 : top;
+	}
+
+	//registers the Debug.Profile functions, then starts if set_options asked to (ComponentDB::init)
+	static void add_functions(lua_State* state);
+
+	static void start(int sample_instructions);
+	static void stop();
+	static bool is_enabled() { return enabled; }
+
+	//writes collapsed stacks into PROFILE_FOLDER_PATH: <name>_time.folded (self microseconds),
+	//<name>_alloc.folded (self bytes) and, if sampling ran, <name>_samples.folded (sample counts);
+	//prints an error and returns false if the files can't be opened (callers decide whether that ends the game)
+	static bool write_folded(const std::string& name);
+
+	//prints the top zones every summary_frames frames (after Renderer::disp)
+	static void end_frame();
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	struct zone_key {
+		uint32_t type_id;
+		const char* callback;		//string literal, compared by address
+		int actor_id;
+		bool operator==(const zone_key& o) const { return type_id == o.type_id && callback == o.callback && actor_id == o.actor_id; }
+	};
+	struct zone_key_hash {
+		size_t operator()(const zone_key& k) const {
+			size_t h = std::hash<uint64_t>()((static_cast<uint64_t>(k.type_id) << 32) | static_cast<uint32_t>(k.actor_id));
+			return h ^ (std::hash<const void*>()(k.callback) + 0x9e3779b9 + (h << 6) + (h >> 2));
+		}
+	};
+
+	struct zone_totals {
+		std::string actor_name;
+		uint64_t calls = 0;
+		uint64_t self_ticks = 0;		//performance counter ticks, children excluded
+		uint64_t total_ticks = 0;
+		uint64_t self_bytes = 0;		//requested from the lua allocator
+		uint64_t window_calls = 0;		//since the last summary
+		uint64_t window_ticks = 0;
+		uint64_t window_bytes = 0;
+	};
+
+	struct open_zone {
+		zone_totals* totals;
+		zone_key key;
+		uint64_t start_ticks;
+		uint64_t start_bytes;
+		uint64_t child_ticks;
+		uint64_t child_bytes;
+	};
+
+	static inline bool enabled = false;
+	static inline bool start_on_init = false;
+	static inline lua_State* L = nullptr;
+	static inline int sample_interval = 0;
+	static inline int summary_frames = 0;
+	static inline int summary_top = 10;
+	static inline int frames_since_summary = 0;
+	static inline uint64_t window_start = 0;
+
+	static inline std::unordered_map<zone_key, zone_totals, zone_key_hash> zones;
+	static inline std::vector<open_zone> open_zones;
+	static inline std::unordered_map<std::string, uint64_t> samples;	//collapsed stack -> count
+	static inline uint64_t sample_count = 0;
+	static inline uint64_t profiled_ticks = 0;		//outermost zones only
+
+	static void enter(uint32_t type_id, const char* callback, const Actor* actor);
+	static void leave();
+
+	static std::string zone_frame(const zone_key& key);
+	static void hook(lua_State* L, lua_Debug* ar);
+	static uint64_t allocated_bytes();
+	static void print_summary(int top, double window_ms);
+	//atexit handler: must not call exit or throw, so a failed write is only reported
+	static void write_on_exit();
+
+	//lua: Debug.ProfileStart([sample_instructions]), Debug.ProfileStop(), Debug.ProfileWrite(name),
+	//Debug.ProfileSummary([top])
+	static int lua_start(lua_State* L);
+	static int lua_stop(lua_State* L);
+	static int lua_write(lua_State* L);
+	static int lua_summary(lua_State* L);
+};
+
+#endif
@@ -125,6 +125,39 @@ void Renderer::draw_sprite_Ex(const std::string& img_name, float x, float y, flo
 	spriteQueue.push_back(new_req);
 }
 
+void Renderer::queue_sprite(SDL_Texture* tex, float x, float y, float rotation_degrees, float scale_x, float scale_y,
+							float pivot_x, float pivot_y, uint8_t r, uint8_t g, uint8_t b, uint8_t a, int sorting_order,
+							const SDL_Rect* src)
+{
+	sprite_params new_req;
+
+	new_req.tex = tex;
+	if (src != nullptr) new_req.src = *src;
+	new_req.x = x;
+	new_req.y = y;
+	new_req.scale_x *= scale_x;
+	new_req.scale_y *= scale_y;
+	new_req.pivot_x = pivot_x;
+	new_req.pivot_y = pivot_y;
+	new_req.r = r;
+	new_req.g = g;
+	new_req.b = b;
+	new_req.a = a;
+	new_req.rot_deg = static_cast<int>(rotation_degrees);
+	new_req.order = sorting_order;
+
+	spriteQueue.push_back(new_req);
+}
+
+SDL_Vertex* Renderer::queue_quads(SDL_Texture* tex, size_t count, int sorting_order)
+{
+	size_t first = geometry_vertices.size();
+	geometry_vertices.resize(first + count * 4);
+	geometryQueue.push_back({ tex, sorting_order, first, count });
+
+	return geometry_vertices.data() + first;
+}
+
 void Renderer::draw_UI(const std::string& img_name, float x, float y)
 {
 	UI_params new_req;
@@ -152,6 +185,22 @@ void Renderer::draw_UI_Ex(const std::string& img_name, float x, float y, float r
 	UIQueue.push_back(new_req);
 }
 
+void Renderer::queue_UI(SDL_Texture* tex, float x, float y, uint8_t r, uint8_t g, uint8_t b, uint8_t a, int sorting_order)
+{
+	UI_params new_req;
+
+	new_req.tex = tex;
+	new_req.x = static_cast<int>(x);
+	new_req.y = static_cast<int>(y);
+	new_req.r = r;
+	new_req.g = g;
+	new_req.b = b;
+	new_req.a = a;
+	new_req.order = sorting_order;
+
+	UIQueue.push_back(new_req);
+}
+
 void Renderer::draw_text(const std::string& text, float x, float y, const std::string& font_name, float font_size, float r, float g, float b, float a)
 {
 	text_params new_req;
@@ -228,6 +277,8 @@ void Renderer::discard_frame()
 	check_init();
 
 	spriteQueue.clear();
+	geometryQueue.clear();
+	geometry_vertices.clear();
 	UIQueue.clear();
 	textQueue.clear();
 	pxQueue.clear();
@@ -320,22 +371,36 @@ void Renderer::disp_tiles()
 void Renderer::disp_sprites()
 {
 	std::stable_sort(spriteQueue.begin(), spriteQueue.end(), comp);
+	std::stable_sort(geometryQueue.begin(), geometryQueue.end(),
+		[](const geometry_batch& lhs, const geometry_batch& rhs) { return lhs.order < rhs.order; });
 
 	SDL_RenderSetScale(r, scale, scale);
 
+	size_t next_batch = 0;
 	while (!spriteQueue.empty()) {
 
 		sprite_params req = spriteQueue.front();
 		spriteQueue.pop_front();
 
+		//batches go under sprites with the same order
+		while (next_batch < geometryQueue.size() && geometryQueue[next_batch].order <= req.order) {
+			disp_geometry(geometryQueue[next_batch++]);
+		}
+
 		glm::vec2 cam_world_pos = cam_pos;
 
 		//where in world units the image's pivot will be on the screen, with (0, 0) being the top left corner
 		glm::vec2 render_pos = cam_world_pos - (cam_world_pos - glm::vec2(req.x, req.y)) / scale;
 
-		SDL_Texture* tex = ImageDB::get_image(req.img_name);
+		SDL_Texture* tex = req.tex != nullptr ? req.tex : ImageDB::get_image(req.img_name);
 		SDL_Rect tex_rect;
-		SDL_QueryTexture(tex, NULL, NULL, &tex_rect.w, &tex_rect.h);
+		if (req.src.w > 0) {
+			tex_rect.w = req.src.w;
+			tex_rect.h = req.src.h;
+		}
+		else {
+			SDL_QueryTexture(tex, NULL, NULL, &tex_rect.w, &tex_rect.h);
+		}
 
 		//scale
 		int flip = SDL_FLIP_NONE;
@@ -356,15 +421,45 @@ void Renderer::disp_sprites()
 		SDL_SetTextureColorMod(tex, req.r, req.g, req.b);
 		SDL_SetTextureAlphaMod(tex, req.a);
 
-		Helper::SDL_RenderCopyEx498(0, "", r, tex, NULL, &tex_rect, req.rot_deg, &pivot, static_cast<SDL_RendererFlip>(flip));
+		Helper::SDL_RenderCopyEx498(0, "", r, tex, req.src.w > 0 ? &req.src : NULL, &tex_rect, req.rot_deg, &pivot, static_cast<SDL_RendererFlip>(flip));
 
 		SDL_SetTextureColorMod(tex, 255, 255, 255);
 		SDL_SetTextureAlphaMod(tex, 255);
 	}
 
+	while (next_batch < geometryQueue.size()) {
+		disp_geometry(geometryQueue[next_batch++]);
+	}
+	geometryQueue.clear();
+	geometry_vertices.clear();
+
 	SDL_RenderSetScale(r, 1, 1);
 }
 
+void Renderer::disp_geometry(const geometry_batch& batch)
+{
+	if (batch.quads == 0) return;
+
+	size_t index_count = batch.quads * 6;
+	for (size_t q = quad_indices.size() / 6; q < batch.quads; ++q) {
+		int v = static_cast<int>(q * 4);
+		quad_indices.insert(quad_indices.end(), { v, v + 1, v + 2, v + 2, v + 3, v });
+	}
+
+	//same world -> screen mapping as disp_sprites, applied per vertex
+	SDL_Vertex* vertices = geometry_vertices.data() + batch.first_vertex;
+	for (size_t i = 0; i < batch.quads * 4; ++i) {
+		glm::vec2 render_pos = cam_pos - (cam_pos - glm::vec2(vertices[i].position.x, vertices[i].position.y)) / scale;
+		vertices[i].position.x = scaled_ppu.x * render_pos.x;
+		vertices[i].position.y = scaled_ppu.y * render_pos.y;
+	}
+
+	//untextured batches blend with the draw blend mode rather than a texture's
+	if (batch.tex == nullptr) SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_BLEND);
+	SDL_RenderGeometry(r, batch.tex, vertices, static_cast<int>(batch.quads * 4), quad_indices.data(), static_cast<int>(index_count));
+	if (batch.tex == nullptr) SDL_SetRenderDrawBlendMode(r, SDL_BLENDMODE_NONE);
+}
+
 void Renderer::disp_UI()
 {
 	std::stable_sort(UIQueue.begin(), UIQueue.end(), comp);
@@ -374,7 +469,7 @@ void Renderer::disp_UI()
 		UI_params req = UIQueue.front();
 		UIQueue.pop_front();
 
-		SDL_Texture* img = ImageDB::get_image(req.img_name);
+		SDL_Texture* img = req.tex != nullptr ? req.tex : ImageDB::get_image(req.img_name);
 
 		int w = 0, h = 0;
 		SDL_QueryTexture(img, NULL, NULL, &w, &h);
@@ -28,8 +28,28 @@ public:
 	static void draw_sprite_Ex(const std::string& img_name, float x, float y, float rotation_degrees, float scale_x, float scale_y,
 							   float pivot_x, float pivot_y, float r, float g, float b, float a, float sorting_order);
 
+	//queues a sprite whose texture is already resolved (native SpriteRenderer pass); scale < 0 flips,
+	//src (if given) is the part of the texture to draw
+	static void queue_sprite(SDL_Texture* tex, float x, float y, float rotation_degrees, float scale_x, float scale_y,
+							 float pivot_x, float pivot_y, uint8_t r, uint8_t g, uint8_t b, uint8_t a, int sorting_order,
+							 const SDL_Rect* src = nullptr);
+
+	//reserves count quads drawn with one SDL_RenderGeometry call, sorted with sprites by sorting_order;
+	//fill the 4 * count vertices (top left, top right, bottom right, bottom left) with world positions, colors
+	//and uvs. the pointer is only valid until the next call
+	static SDL_Vertex* queue_quads(SDL_Texture* tex, size_t count, int sorting_order);
+
+	//whether a circle of radius (world units) around pos can touch the camera's view
+	static bool is_visible(const glm::vec2& pos, float radius) {
+		glm::vec2 lo = get_camera_world_min();
+		glm::vec2 hi = get_camera_world_max();
+		return pos.x + radius >= lo.x && pos.x - radius <= hi.x && pos.y + radius >= lo.y && pos.y - radius <= hi.y;
+	}
+
 	static void draw_UI(const std::string& img_name, float x, float y);
 	static void draw_UI_Ex(const std::string& img_name, float x, float y, float r, float g, float b, float a, float sorting_order);
+	//draw_UI_Ex with the texture already resolved
+	static void queue_UI(SDL_Texture* tex, float x, float y, uint8_t r, uint8_t g, uint8_t b, uint8_t a, int sorting_order);
 	
 	static void draw_text(const std::string& text, float x, float y, const std::string& font_name, float font_size, float r, float g, float b, float a);
 	
@@ -43,6 +63,10 @@ public:
 	static void set_camera_zoom(float factor);
 	static float get_camera_zoom() { return scale; }
 
+	//visible area in world units
+	static glm::vec2 get_camera_world_min() { return cam_pos - cam_dims / 2.f / scale; }
+	static glm::vec2 get_camera_world_max() { return cam_pos + cam_dims / 2.f / scale; }
+
 	static glm::ivec2 get_image_size(const std::string& img_name);
 
 	static const glm::vec2& get_ppu() { return ppu; }
@@ -82,6 +106,8 @@ private:
 
 	struct sprite_params : params{
 		std::string img_name;
+		SDL_Texture* tex = nullptr;		//set by queue_sprite, otherwise looked up from img_name
+		SDL_Rect src = { 0, 0, 0, 0 };	//w == 0 draws the whole texture
 		float x = 0;
 		float y = 0;
 		int rot_deg = 0;
@@ -91,6 +117,7 @@ private:
 
 	struct UI_params : params {
 		std::string img_name;
+		SDL_Texture* tex = nullptr;		//set by queue_UI, otherwise looked up from img_name
 		int x = 0;
 		int y = 0;
 	};
@@ -117,6 +144,13 @@ private:
 
 	static inline params_compare comp;
 
+	struct geometry_batch {
+		SDL_Texture* tex;
+		int order;
+		size_t first_vertex;
+		size_t quads;
+	};
+
 #ifdef DEBUG
 	struct RectParams {
 		SDL_Rect rect;
@@ -136,6 +170,11 @@ private:
 	static inline std::deque<text_params> textQueue;
 	static inline std::deque<px_params> pxQueue;
 
+	//queue_quads batches; vertices are in world units until disp_geometry
+	static inline std::vector<geometry_batch> geometryQueue;
+	static inline std::vector<SDL_Vertex> geometry_vertices;
+	static inline std::vector<int> quad_indices;		//0 1 2 2 3 0, + 4 per quad; shared by every batch
+
 	//rendering info
 	static inline SDL_Color clearColor;										//window clear color
 	static inline glm::vec2 ppu = { 1, 1 };									//screen pixels per world unit
@@ -160,6 +199,7 @@ private:
 
 	static void disp_tiles();
 	static void disp_sprites();
+	static void disp_geometry(const geometry_batch& batch);
 	static void disp_UI();
 	static void disp_text();
 	static void disp_px();
@@ -15,6 +15,19 @@
 #include "Helper.h"
 #include "AudioDB.h"
 #include "ComponentDB.h"
+#include "Interner.h"
+#include "CollisionDB.h"
+#include "ComponentStore.h"
+#include "NativeComponentDB.h"
+#include "AnimationDB.h"
+#include "ParticleDB.h"
+#include "TweenDB.h"
+#include "CoroutineDB.h"
+#include "TimerDB.h"
+#include "EventDB.h"
+#include "ShardDB.h"
+#include "LuaGC.h"
+#include "Profiler.h"
 
 using std::cout;
 using std::endl;
@@ -32,6 +45,8 @@ void SceneDB::init(rapidjson::Document& d)
 
 	initialized = true;
 
+	start_counter = SDL_GetPerformanceCounter();
+
 	load_scene(d);
 }
 
@@ -82,40 +97,174 @@ void SceneDB::load_scene(rapidjson::Document& d)
 
 		}
 	}
+
+	//loading leaves json overrides, template copies and the previous scene's tables behind; clear them before play
+	LuaGC::full_collect();
 }
 
 bool SceneDB::tick()
 {
 	check_init();
 
+	float now = static_cast<float>(static_cast<double>(SDL_GetPerformanceCounter() - start_counter) / SDL_GetPerformanceFrequency());
+	if (frame > 0) frame_dt = now - frame_time;
+	frame_time = now;
+
 	if (map.get() != nullptr)
 		map->draw();
 
+	update_activation();
 
+	run_pending_starts();
+
+	//components added at runtime still get their OnStart on the frame after they were added
 	for (shared_ptr<Actor>& a : running_actors) {
-		a->start();
+		if (a->has_started()) a->start();
 	}
 
+	//parallel components update on the shard threads while the main state runs its own
+	ShardDB::begin_update(frame_dt);
 	for (shared_ptr<Actor>& a : running_actors) {
-		a->update();
+		a->update(frame, now);
 	}
+	ShardDB::end_update();
+	NativeComponentDB::update(frame_dt);
+	CoroutineDB::update(frame, now);
+	TimerDB::update(now);
+	AnimationDB::update(frame_dt);
+	TweenDB::update(frame_dt);
+
+	//collision callbacks see every actor's post-update position
+	Transform::update_hierarchy();
+	ComponentStore::sync_transforms();
+	CollisionDB::step();
 
 	for (shared_ptr<Actor>& a : running_actors) {
 		a->late_update();
 	}
+	NativeComponentDB::late_update();
+
+	//everything published this frame, in publish order
+	EventDB::deliver();
 
 	//add new actors to running list
 	for (shared_ptr<Actor>& a : new_actors) {
 		running_actors.emplace_back(a);
+		start_queue.emplace_back(a, a->id);
+		if (a->activation.enabled) register_activation(a.get());
 	}
 	new_actors.clear();
 
+	//late updates may have moved things since the collision pass
+	ComponentStore::sync_transforms();
+	ComponentStore::submit_sprites();
+	ParticleDB::update(frame_dt);
+
 	//clean up any destroyed actors
-	to_destroy.clear();
+	release_destroyed();
+
+	++frame;
 
 	return false;
 }
 
+void SceneDB::set_start_budget(int budget_us, int budget_actors)
+{
+	start_budget_us = std::max(budget_us, 0);
+	start_budget_actors = std::max(budget_actors, 0);
+}
+
+void SceneDB::set_activation_params(float cell_size, float margin)
+{
+	if (cell_size <= 0.f) {
+		cout << "error: activation_cell_size must be positive";
+		exit(0);
+	}
+
+	if (!activation_actors.empty()) {
+		cout << "error: tried to change activation params after actors registered";
+		exit(0);
+	}
+
+	activation_grid.set_cell_size(cell_size);
+	activation_margin = std::max(margin, 0.f);
+}
+
+void SceneDB::register_activation(Actor* a)
+{
+	if (a->activation.registered) return;
+
+	a->activation.registered = true;
+	a->activation.cell = activation_grid.cell_of(a->get_position());
+	activation_grid.insert(a, a->activation.cell);
+	a->activation.idx = static_cast<uint32_t>(activation_actors.size());
+	activation_actors.push_back(a);
+
+	//actors start awake; the next update_activation puts it to sleep if it isn't near the camera
+	a->activation.asleep = false;
+	activation_changes.push_back(a);
+}
+
+void SceneDB::unregister_activation(Actor* a)
+{
+	if (!a->activation.registered) return;
+
+	remove_activation(a);
+
+	//leaving the system means always awake
+	a->set_asleep(false);
+}
+
+void SceneDB::set_spatial_cell_size(float cell_size)
+{
+	if (cell_size <= 0.f) {
+		cout << "error: spatial_cell_size must be positive";
+		exit(0);
+	}
+
+	if (spatial_index.size() != 0) {
+		cout << "error: tried to change spatial_cell_size after actors were indexed";
+		exit(0);
+	}
+
+	spatial_index.set_cell_size(cell_size);
+}
+
+luabridge::LuaRef SceneDB::query_rect(float x, float y, float w, float h)
+{
+	apply_moves();
+
+	query_results.clear();
+	spatial_index.query_rect(glm::vec2(x, y), glm::vec2(x + w, y + h), query_results);
+
+	//cells come back in hash order; give scripts load order
+	std::sort(query_results.begin(), query_results.end(), [](const Actor* a, const Actor* b) { return a->id < b->id; });
+	return results_to_table();
+}
+
+luabridge::LuaRef SceneDB::query_radius(float x, float y, float r)
+{
+	apply_moves();
+
+	query_results.clear();
+	spatial_index.query_radius(glm::vec2(x, y), r, query_results);
+
+	std::sort(query_results.begin(), query_results.end(), [](const Actor* a, const Actor* b) { return a->id < b->id; });
+	return results_to_table();
+}
+
+luabridge::LuaRef SceneDB::query_nearest(float x, float y, int k)
+{
+	apply_moves();
+
+	query_results.clear();
+	if (k > 0)
+		spatial_index.nearest(glm::vec2(x, y), static_cast<size_t>(k), query_results);
+
+	//already nearest first
+	return results_to_table();
+}
+
 void SceneDB::keep_actor(const luabridge::LuaRef& actor)
 {
 	Actor* a = actor;
@@ -149,12 +298,27 @@ std::vector<Actor*>& SceneDB::get_actors(const std::string& name)
 luabridge::LuaRef SceneDB::cpp_instantiate(const std::string templ_name)
 {
 	const Actor* temp = TemplateDB::get_template_actor(templ_name);
-	actors.emplace_back(new Actor(temp));
-	shared_ptr<Actor> a = actors.back();
-	new_actors.emplace_back(a);
+	shared_ptr<Actor> a = spawn(temp);
 	return luabridge::LuaRef(ComponentDB::get_state(), a.get());
 }
 
+luabridge::LuaRef SceneDB::cpp_instantiate_many(const std::string templ_name, int n)
+{
+	luabridge::LuaRef ret_table = luabridge::newTable(ComponentDB::get_state());
+	if (n <= 0) return ret_table;
+
+	const Actor* temp = TemplateDB::get_template_actor(templ_name);
+
+	actors.reserve(actors.size() + n);
+	new_actors.reserve(new_actors.size() + n);
+
+	for (int i = 0; i < n; ++i) {
+		shared_ptr<Actor> a = spawn(temp);
+		ret_table[i + 1] = a.get();
+	}
+	return ret_table;
+}
+
 void SceneDB::cpp_destroy(const luabridge::LuaRef& actor)
 {
 	Actor* a = actor;
@@ -164,12 +328,93 @@ void SceneDB::cpp_destroy(const luabridge::LuaRef& actor)
 			local = actors[i];
 			actors.erase(actors.begin() + i);
 			local->set_active(false);
+			TimerDB::release(local.get());
+			EventDB::release(local.get());
 			to_destroy.push_back(local);
 			break;
 		}
 	}
 }
 
+void SceneDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	size_t bytes = 0;
+	for (const shared_ptr<Actor>& a : actors) {
+		bytes += a->get_footprint();
+	}
+
+	out.emplace_back("actors", static_cast<double>(actors.size()));
+	out.emplace_back("running_actors", static_cast<double>(running_actors.size()));
+	out.emplace_back("actor_bytes", static_cast<double>(bytes));
+	out.emplace_back("bytes_per_actor", actors.empty() ? 0.0 : static_cast<double>(bytes) / actors.size());
+	out.emplace_back("interned_strings", static_cast<double>(Interner::size()));
+
+	size_t sleeping = 0;
+	for (const Actor* a : activation_actors) {
+		if (a->activation.asleep) ++sleeping;
+	}
+	out.emplace_back("activation_tracked", static_cast<double>(activation_actors.size()));
+	out.emplace_back("activation_sleeping", static_cast<double>(sleeping));
+
+	out.emplace_back("spatial_indexed", static_cast<double>(spatial_index.size()));
+	out.emplace_back("spatial_cells", static_cast<double>(spatial_index.cell_count()));
+
+	out.emplace_back("transform_hierarchy", static_cast<double>(Transform::get_hierarchy_size()));
+
+	ComponentStore::collect_stats(out);
+	NativeComponentDB::collect_stats(out);
+	AnimationDB::collect_stats(out);
+	ParticleDB::collect_stats(out);
+	TweenDB::collect_stats(out);
+	CoroutineDB::collect_stats(out);
+	TimerDB::collect_stats(out);
+	EventDB::collect_stats(out);
+	ShardDB::collect_stats(out);
+	CollisionDB::collect_stats(out);
+	ComponentDB::collect_stats(out);
+	Profiler::collect_stats(out);
+
+	size_t pending_starts = 0;
+	for (const auto& entry : start_queue) {
+		if (needs_start(entry)) ++pending_starts;
+	}
+	out.emplace_back("start_backlog", static_cast<double>(pending_starts));
+
+	size_t pooled = 0;
+	for (const auto& pool : actor_pools) {
+		pooled += pool.second.size();
+	}
+	size_t spawns = pool_hits + pool_misses;
+	out.emplace_back("pooled_actors", static_cast<double>(pooled));
+	out.emplace_back("pool_hits", static_cast<double>(pool_hits));
+	out.emplace_back("pool_misses", static_cast<double>(pool_misses));
+	out.emplace_back("pool_hit_rate", spawns == 0 ? 0.0 : static_cast<double>(pool_hits) / spawns);
+	out.emplace_back("released_handles", static_cast<double>(LuaHandles::get_released()));
+}
+
+luabridge::LuaRef SceneDB::get_stats()
+{
+	std::vector<std::pair<std::string, double>> stats;
+	collect_stats(stats);
+
+	luabridge::LuaRef ret_table = luabridge::newTable(ComponentDB::get_state());
+	for (const auto& stat : stats) {
+		ret_table[stat.first] = stat.second;
+	}
+	return ret_table;
+}
+
+void SceneDB::dump_stats()
+{
+	std::vector<std::pair<std::string, double>> stats;
+	collect_stats(stats);
+
+	cout << "---- scene stats (frame " << Helper::GetFrameNumber() << ") ----" << endl;
+	for (const auto& stat : stats) {
+		cout << stat.first << ": " << stat.second << endl;
+	}
+}
+
 
 /* ------------------------ private ------------------------ */
 
@@ -180,6 +425,302 @@ void SceneDB::check_init() {
 	}
 }
 
+void SceneDB::update_activation()
+{
+	//cell range covered by the camera plus margin this frame
+	glm::ivec2 new_min = activation_grid.cell_of(Renderer::get_camera_world_min() - activation_margin);
+	glm::ivec2 new_max = activation_grid.cell_of(Renderer::get_camera_world_max() + activation_margin);
+
+	glm::ivec2 old_min = active_min;
+	glm::ivec2 old_max = active_max;
+	active_min = new_min;
+	active_max = new_max;
+
+	//only actors reported as moved can have changed cell
+	apply_moves();
+
+	//only cells that entered or left the range can change state when the camera moves
+	if (new_min != old_min || new_max != old_max) {
+		auto visit_range = [](const glm::ivec2& lo, const glm::ivec2& hi, const glm::ivec2& other_lo, const glm::ivec2& other_hi) {
+			for (int x = lo.x; x <= hi.x; ++x) {
+				for (int y = lo.y; y <= hi.y; ++y) {
+					//skip cells in both ranges
+					if (x >= other_lo.x && x <= other_hi.x && y >= other_lo.y && y <= other_hi.y) continue;
+
+					const std::vector<Actor*>* bucket = activation_grid.get_cell(glm::ivec2(x, y));
+					if (bucket == nullptr) continue;
+
+					activation_changes.insert(activation_changes.end(), bucket->begin(), bucket->end());
+				}
+			}
+		};
+
+		visit_range(old_min, old_max, new_min, new_max);
+		visit_range(new_min, new_max, old_min, old_max);
+	}
+
+	//actors held back last frame get their first evaluation once OnStart has run
+	if (!activation_unstarted.empty()) {
+		auto started = std::stable_partition(activation_unstarted.begin(), activation_unstarted.end(), [](const Actor* a) { return !a->has_started(); });
+		activation_changes.insert(activation_changes.end(), started, activation_unstarted.end());
+		activation_unstarted.erase(started, activation_unstarted.end());
+	}
+
+	//callbacks last, since OnSleep / OnWake may register or unregister actors (state is re-read, so duplicates are harmless)
+	for (size_t i = 0; i < activation_changes.size(); ++i) {
+		Actor* a = activation_changes[i];
+		if (!a->is_active() || !a->activation.registered) continue;
+
+		//no OnSleep / OnWake before OnStart; spawns are queued here before their start runs
+		if (!a->has_started()) {
+			if (std::find(activation_unstarted.begin(), activation_unstarted.end(), a) == activation_unstarted.end())
+				activation_unstarted.push_back(a);
+			continue;
+		}
+		a->set_asleep(!cell_active(a->activation.cell));
+	}
+	activation_changes.clear();
+}
+
+void SceneDB::apply_moves()
+{
+	for (Actor* a : moved_actors) {
+		a->move_queued = false;
+		glm::vec2 pos = a->get_position();
+
+		glm::ivec2 cell = spatial_index.cell_of(pos);
+		if (cell != a->index_cell) {
+			spatial_index.move(a, a->index_cell, cell);
+			a->index_cell = cell;
+		}
+
+		if (!a->activation.registered) continue;
+
+		cell = activation_grid.cell_of(pos);
+		if (cell == a->activation.cell) continue;
+
+		activation_grid.move(a, a->activation.cell, cell);
+		a->activation.cell = cell;
+
+		//judged against the current range; if the camera moves next frame the cells entering or leaving it are revisited
+		if (cell_active(cell) == a->activation.asleep)
+			activation_changes.push_back(a);
+	}
+	moved_actors.clear();
+}
+
+void SceneDB::remove_activation(Actor* a)
+{
+	a->activation.registered = false;
+	activation_grid.remove(a, a->activation.cell);
+
+	Actor* last = activation_actors.back();
+	activation_actors[a->activation.idx] = last;
+	last->activation.idx = a->activation.idx;
+	activation_actors.pop_back();
+
+	forget_activation_changes(a);
+}
+
+void SceneDB::forget_activation_changes(Actor* a)
+{
+	activation_changes.erase(std::remove(activation_changes.begin(), activation_changes.end(), a), activation_changes.end());
+	activation_unstarted.erase(std::remove(activation_unstarted.begin(), activation_unstarted.end(), a), activation_unstarted.end());
+}
+
+void SceneDB::index_actor(Actor* a)
+{
+	if (a->indexed) return;
+
+	a->indexed = true;
+	a->store_slot = ComponentStore::add_actor(a);
+	a->index_cell = spatial_index.cell_of(a->get_position());
+	spatial_index.insert(a, a->index_cell);
+
+	a->attach_native_components();
+}
+
+void SceneDB::unindex_actor(Actor* a)
+{
+	if (!a->indexed) return;
+
+	a->detach_native_components();
+	TweenDB::release(a);
+	CoroutineDB::release(a);
+	//again: its callbacks may have started timers / subscribed after cpp_destroy released the first ones
+	TimerDB::release(a);
+	EventDB::release(a);
+
+	a->indexed = false;
+	spatial_index.remove(a, a->index_cell);
+
+	ComponentStore::remove_actor(a->store_slot);
+	a->store_slot = UINT32_MAX;
+}
+
+luabridge::LuaRef SceneDB::results_to_table()
+{
+	luabridge::LuaRef ret_table = luabridge::newTable(ComponentDB::get_state());
+	int n = 0;
+	for (Actor* a : query_results) {
+		if (a->is_active()) ret_table[++n] = a;
+	}
+	return ret_table;
+}
+
+#ifdef DEBUG
+void SceneDB::benchmark_spatial()
+{
+	const int QUERIES = 1000;
+	const float WORLD = 1000.f;
+
+	for (int n : { 1000, 10000, 100000 }) {
+		std::vector<Actor> bench_actors(n);
+		SpatialGrid grid(spatial_index.get_cell_size());
+
+		for (Actor& a : bench_actors) {
+			a.get_transform().position = glm::vec2(WORLD * std::rand() / RAND_MAX, WORLD * std::rand() / RAND_MAX);
+			grid.insert(&a, grid.cell_of(a.get_position()));
+		}
+
+		std::vector<glm::vec2> centers;
+		for (int i = 0; i < QUERIES; ++i) {
+			centers.emplace_back(WORLD * std::rand() / RAND_MAX, WORLD * std::rand() / RAND_MAX);
+		}
+
+		const float radius = 10.f;
+		std::vector<Actor*> out;
+		size_t brute_hits = 0;
+		size_t grid_hits = 0;
+
+		uint64_t t0 = SDL_GetPerformanceCounter();
+		for (const glm::vec2& c : centers) {
+			out.clear();
+			for (Actor& a : bench_actors) {
+				glm::vec2 d = a.get_position() - c;
+				if (glm::dot(d, d) <= radius * radius) out.push_back(&a);
+			}
+			brute_hits += out.size();
+		}
+		uint64_t t1 = SDL_GetPerformanceCounter();
+		for (const glm::vec2& c : centers) {
+			out.clear();
+			grid.query_radius(c, radius, out);
+			grid_hits += out.size();
+		}
+		uint64_t t2 = SDL_GetPerformanceCounter();
+		for (const glm::vec2& c : centers) {
+			out.clear();
+			grid.nearest(c, 8, out);
+		}
+		uint64_t t3 = SDL_GetPerformanceCounter();
+
+		double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+		cout << n << " actors, " << QUERIES << " radius queries: brute " << (t1 - t0) / freq * 1000.0 << " ms, grid "
+			<< (t2 - t1) / freq * 1000.0 << " ms (" << brute_hits << "/" << grid_hits << " hits), nearest(8) "
+			<< (t3 - t2) / freq * 1000.0 << " ms" << endl;
+	}
+}
+#endif
+
+void SceneDB::run_pending_starts()
+{
+	//actors flagged with StartImmediately jump the queue and ignore the budget
+	if (immediate_start_requests > 0) {
+		immediate_start_requests = 0;
+		for (size_t i = 0; i < start_queue.size(); ++i) {
+			auto& entry = start_queue[i];
+			if (needs_start(entry) && entry.first->wants_immediate_start())
+				entry.first->start();
+		}
+	}
+
+	uint64_t begin = SDL_GetPerformanceCounter();
+	uint64_t budget_ticks = static_cast<uint64_t>(start_budget_us) * SDL_GetPerformanceFrequency() / 1000000;
+	int started = 0;
+
+	while (!start_queue.empty()) {
+		if (start_budget_actors > 0 && started >= start_budget_actors) break;
+		//always start at least one actor so the backlog drains no matter how slow OnStart is
+		if (start_budget_us > 0 && started > 0 && SDL_GetPerformanceCounter() - begin >= budget_ticks) break;
+
+		auto entry = start_queue.front();
+		start_queue.pop_front();
+
+		//destroyed before starting, or already started immediately
+		if (!needs_start(entry)) continue;
+
+		entry.first->start();
+		++started;
+	}
+}
+
+shared_ptr<Actor> SceneDB::spawn(const Actor* temp)
+{
+	shared_ptr<Actor> a = nullptr;
+
+	auto pool = actor_pools.find(temp);
+	if (pool != actor_pools.end() && !pool->second.empty()) {
+		a = pool->second.back();
+		pool->second.pop_back();
+		a->reset_to_template(temp);
+		++pool_hits;
+	}
+	else {
+		a = shared_ptr<Actor>(new Actor(temp));
+		++pool_misses;
+	}
+
+	actors.emplace_back(a);
+	new_actors.emplace_back(a);
+	index_actor(a.get());
+	return a;
+}
+
+void SceneDB::release_destroyed()
+{
+	if (to_destroy.empty()) return;
+
+	running_actors.erase(std::remove_if(running_actors.begin(), running_actors.end(),
+		[](const shared_ptr<Actor>& a) { return !a->is_active(); }), running_actors.end());
+
+	//callbacks below may destroy more actors; those are released next frame
+	std::vector<shared_ptr<Actor>> releasing;
+	releasing.swap(to_destroy);
+
+	for (shared_ptr<Actor>& a : releasing) {
+		unindex_actor(a.get());
+	}
+
+	//one pass instead of a search per actor; only unindexed actors in the list are the ones being released
+	moved_actors.erase(std::remove_if(moved_actors.begin(), moved_actors.end(), [](Actor* a) {
+		if (a->indexed) return false;
+		a->move_queued = false;
+		return true;
+	}), moved_actors.end());
+
+	//contacts with the removed colliders end now, while their actors can still be handed to OnCollisionExit / OnTriggerExit
+	CollisionDB::purge_dead();
+
+	for (shared_ptr<Actor>& a : releasing) {
+		//scripts may still hold the actor; from here on it is freed or recycled, so their handles must error instead
+		LuaHandles::release(a.get());
+		LuaHandles::release(&a->get_transform());
+		a->get_transform().detach();
+
+		if (a->activation.registered) remove_activation(a.get());
+	}
+
+	for (shared_ptr<Actor>& a : releasing) {
+		const Actor* temp = a->get_source_template();
+		if (temp == nullptr) continue;
+
+		std::vector<shared_ptr<Actor>>& pool = actor_pools[temp];
+		if (pool.size() < POOL_MAX_PER_TEMPLATE)
+			pool.push_back(a);
+	}
+}
+
 void SceneDB::init_actors(rapidjson::Value& actor_layer)
 {
 	//empty all structures
@@ -212,6 +753,9 @@ void SceneDB::init_actors(rapidjson::Value& actor_layer)
 		shared_ptr<Actor> a = actors.back();
 
 		running_actors.emplace_back(a);
+		start_queue.emplace_back(a, a->id);
+		index_actor(a.get());
+		if (a->activation.enabled) register_activation(a.get());
 
 		//do things with a
 	}
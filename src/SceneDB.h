@@ -7,6 +7,8 @@
 #include <map>
 #include <set>
 #include <memory>
+#include <deque>
+#include <utility>
 
 #include "rapidjson/document.h"
 #include "glm/glm.hpp"
@@ -16,6 +18,8 @@
 #include "Actor.h"
 #include "TemplateDB.h"
 #include "Tilemap.h"
+#include "SpatialGrid.h"
+#include "Consts.h"
 
 class SceneDB
 {
@@ -33,13 +37,51 @@ public:
 
 	static void keep_actor(const luabridge::LuaRef& actor);
 
+	//limits how many first-time OnStarts run per frame; 0 means unlimited
+	static void set_start_budget(int budget_us, int budget_actors);
+	static void request_immediate_start() { ++immediate_start_requests; }
+
+	//hands out phases for components that update every `interval` frames, round robin so each frame gets an even share
+	static int next_update_phase(int interval) { return stagger_counters[interval]++ % interval; }
+	static float get_frame_dt() { return frame_dt; }
+
+	//actors opted into sleeping are awake while their grid cell overlaps the camera rect grown by margin (world units)
+	static void set_activation_params(float cell_size, float margin);
+	static void register_activation(Actor* a);
+	static void unregister_activation(Actor* a);
+	//queues a for re-bucketing; Transform's setters and ComponentStore::sync_transforms report movers, so the
+	//activation pass and the spatial index only visit actors that actually moved
+	static void mark_moved(Actor* a) {
+		if (!a->indexed || a->move_queued) return;
+		a->move_queued = true;
+		moved_actors.push_back(a);
+	}
+
+	//spatial queries over actor positions; moves made through Transform's setters show up at once, plain field
+	//writes from lua once the next transform sync has seen them
+	static void set_spatial_cell_size(float cell_size);
+	static luabridge::LuaRef query_rect(float x, float y, float w, float h);
+	static luabridge::LuaRef query_radius(float x, float y, float r);
+	static luabridge::LuaRef query_nearest(float x, float y, int k);
+
+#ifdef DEBUG
+	//times grid queries against a brute force scan at 1k / 10k / 100k actors
+	static void benchmark_spatial();
+#endif
+
 	static Actor* get_actor(const std::string& name);
 	static std::vector<Actor*>& get_actors(const std::string& name);
 
 	static luabridge::LuaRef cpp_instantiate(const std::string templ_name);
+	static luabridge::LuaRef cpp_instantiate_many(const std::string templ_name, int n);
 	static void cpp_destroy(const luabridge::LuaRef& actor);
 
 
+	//appends name/value pairs describing the running scene (actor counts, memory use)
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+	static luabridge::LuaRef get_stats();
+	static void dump_stats();
+
 	static bool is_init() { return initialized; }
 
 private:
@@ -48,9 +90,43 @@ private:
 	static inline std::vector<std::shared_ptr<Actor>> to_destroy;
 	static inline std::vector<std::shared_ptr<Actor>> running_actors;
 	static inline std::vector<std::shared_ptr<Actor>> new_actors;
+	//running actors waiting on their first OnStart, in creation order, with the id they had when queued
+	//(a pooled actor gets a new id, which invalidates any entry left over from its previous life)
+	static inline std::deque<std::pair<std::shared_ptr<Actor>, int>> start_queue;
+
+	static inline int start_budget_us = 0;
+	static inline int start_budget_actors = 0;
+	static inline int immediate_start_requests = 0;
+
+	//update scheduling
+	static inline std::unordered_map<int, int> stagger_counters;	//interval -> components assigned so far
+	static inline uint32_t frame = 0;								//ticks since init
+	static inline uint64_t start_counter = 0;						//performance counter at init
+	static inline float frame_time = 0.f;							//seconds since init at the start of this tick
+	static inline float frame_dt = 1.f / TARGET_FPS;
+
+	//camera-proximity activation
+	static inline SpatialGrid activation_grid;
+	static inline std::vector<Actor*> activation_actors;			//registered actors (unordered, see remove_activation)
+	static inline std::vector<Actor*> activation_changes;			//actors to re-evaluate once the grid pass is done
+	static inline std::vector<Actor*> activation_unstarted;			//changes held back until OnStart has run
+	static inline float activation_margin = 2.f;
+	static inline glm::ivec2 active_min = { 0, 0 };				//inclusive cell range currently awake
+	static inline glm::ivec2 active_max = { -1, -1 };
+	static inline std::vector<Actor*> moved_actors;				//indexed actors whose position changed, see mark_moved
+
+	//spatial query index over every live actor
+	static inline SpatialGrid spatial_index;
+	static inline std::vector<Actor*> query_results;
 
 	static inline std::shared_ptr<Tilemap> map;
 
+	//destroyed template instances kept for reuse, keyed by the template they were instantiated from
+	static inline const size_t POOL_MAX_PER_TEMPLATE = 1024;
+	static inline std::unordered_map<const Actor*, std::vector<std::shared_ptr<Actor>>> actor_pools;
+	static inline size_t pool_hits = 0;
+	static inline size_t pool_misses = 0;
+
 	static inline bool initialized = false;
 
 	//static inline std::map<float, std::set<int>> actor_y_map; // outer map stores y pos, inner map ordered by load order
@@ -63,6 +139,34 @@ private:
 
 	static void check_init();
 
+	//re-buckets moved actors and wakes / sleeps those whose cell entered or left the camera's range
+	static void update_activation();
+	//re-buckets the actors in moved_actors in the spatial index and the activation grid (queries run it too)
+	static void apply_moves();
+	//takes a out of the grid and activation_actors (the last registered actor fills its place)
+	static void remove_activation(Actor* a);
+	static void forget_activation_changes(Actor* a);
+	static bool cell_active(const glm::ivec2& cell) {
+		return cell.x >= active_min.x && cell.x <= active_max.x && cell.y >= active_min.y && cell.y <= active_max.y;
+	}
+
+	static void index_actor(Actor* a);
+	static void unindex_actor(Actor* a);
+	//turns query_results into a lua array of actors, skipping destroyed ones
+	static luabridge::LuaRef results_to_table();
+
+	//runs first-time OnStarts from start_queue within the frame's budget
+	static void run_pending_starts();
+	static bool needs_start(const std::pair<std::shared_ptr<Actor>, int>& entry) {
+		return entry.first->id == entry.second && entry.first->is_active() && !entry.first->has_started();
+	}
+
+	//creates (or recycles) an instance of temp and queues it to join the running actors
+	static std::shared_ptr<Actor> spawn(const Actor* temp);
+
+	//drops destroyed actors from the running list and returns poolable ones to their pool
+	static void release_destroyed();
+
 	static void init_actors(rapidjson::Value& actor_layer);
 };
 
@@ -0,0 +1,610 @@
+#include "ShardDB.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "EventDB.h"
+#include "Interner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void ShardDB::init(int count)
+{
+	if (!shards.empty()) {
+		cout << "error: double ShardDB init call";
+		exit(0);
+	}
+	if (count <= 0) return;
+	count = std::min(count, MAX_SHARDS);
+
+	static const luaL_Reg SHARD_FUNCTIONS[] = {
+		{ "GetPosition", &ShardDB::lua_get_position },
+		{ "SetPosition", &ShardDB::lua_set_position },
+		{ "GetRotation", &ShardDB::lua_get_rotation },
+		{ "SetRotation", &ShardDB::lua_set_rotation },
+		{ "Send", &ShardDB::lua_shard_send },
+		{ "Publish", &ShardDB::lua_shard_publish },
+		{ nullptr, nullptr }
+	};
+
+	quitting = false;
+	for (int i = 0; i < count; ++i) {
+		shards.emplace_back();
+		shard& s = shards.back();
+
+		s.L = lua_newstate(&LuaAllocator::alloc, &s.allocator);
+		luaL_openlibs(s.L);
+
+		lua_newtable(s.L);
+		lua_pushlightuserdata(s.L, &s);
+		luaL_setfuncs(s.L, SHARD_FUNCTIONS, 1);
+		lua_setglobal(s.L, "Shard");
+
+		s.thread = std::thread(&ShardDB::thread_main, &s);
+	}
+}
+
+void ShardDB::deinit()
+{
+	end_update();
+
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		quitting = true;
+	}
+	pool_wakeup.notify_all();
+
+	for (shard& s : shards) {
+		s.thread.join();
+		lua_close(s.L);
+		s.allocator.release();
+	}
+	shards.clear();
+	type_paths.clear();
+	main_outbox.clear();
+}
+
+void ShardDB::add_functions(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Shard")
+		.addFunction("Send", &ShardDB::lua_main_send)
+		.endNamespace();
+}
+
+void ShardDB::register_if_parallel(lua_State* state, const std::string& type, const std::vector<std::string>& paths)
+{
+	lua_getglobal(state, type.c_str());
+	if (!lua_istable(state, -1)) {
+		lua_pop(state, 1);
+		return;
+	}
+	lua_getfield(state, -1, "parallel");
+	bool parallel = lua_toboolean(state, -1) != 0;
+	lua_pop(state, 1);
+	if (!parallel) {
+		lua_pop(state, 1);
+		return;
+	}
+
+	//the main state keeps only the plain values: json can still override them, and no lifecycle function runs there
+	LuaRef prototype = luabridge::newTable(state);
+	prototype.push(state);
+	lua_pushnil(state);
+	while (lua_next(state, -3) != 0) {
+		if (lua_isfunction(state, -1)) {
+			lua_pop(state, 1);
+			continue;
+		}
+		lua_pushvalue(state, -2);
+		lua_insert(state, -2);
+		lua_rawset(state, -4);
+	}
+	lua_pop(state, 2);
+
+	uint32_t type_id = Interner::get_id(type);
+	type_paths[type_id] = paths;
+
+	ComponentDB::native_type native;
+	native.attach = [type_id](Actor* a, LuaRef& comp) { return attach(type_id, a, comp); };
+	native.detach = [](uint32_t handle) { detach(handle); };
+	ComponentDB::register_native_type(type, prototype, native);
+}
+
+void ShardDB::begin_update(float dt)
+{
+	if (shards.empty()) return;
+
+	//everything sent since the last pass, from the main state or any shard, reaches its target's shard now
+	messages_routed = 0;
+	for (message& m : main_outbox) {
+		route(m);
+	}
+	main_outbox.clear();
+	for (shard& s : shards) {
+		for (message& m : s.outbox) {
+			route(m);
+		}
+		s.outbox.clear();
+	}
+
+	lua_State* main_state = ComponentDB::get_state();
+	for (shard& s : shards) {
+		for (uint32_t row = 0; row < s.actor.size(); ++row) {
+			Actor* a = s.actor[row];
+
+			lua_rawgeti(main_state, LUA_REGISTRYINDEX, s.main_ref[row]);
+			lua_getfield(main_state, -1, "enabled");
+			bool enabled = lua_toboolean(main_state, -1) != 0;
+			lua_pop(main_state, 2);
+
+			s.run[row] = enabled && a->is_active() && a->has_started() && !a->activation.asleep;
+
+			const Transform& t = a->get_transform();
+			s.x[row] = t.position.x;
+			s.y[row] = t.position.y;
+			s.rotation[row] = t.rotation_deg;
+			s.moved[row] = 0;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		phase_dt = dt;
+		running = shards.size();
+		++generation;
+		phase_active = true;
+	}
+	pool_wakeup.notify_all();
+}
+
+void ShardDB::end_update()
+{
+	if (!phase_active) return;
+
+	{
+		std::unique_lock<std::mutex> lock(pool_mutex);
+		pool_done.wait(lock, []() { return running == 0; });
+		phase_active = false;
+	}
+
+	lua_State* main_state = ComponentDB::get_state();
+	for (size_t i = 0; i < shards.size(); ++i) {
+		shard& s = shards[i];
+
+		for (std::string& e_msg : s.errors) {
+			std::replace(e_msg.begin(), e_msg.end(), '\\', '/');
+			cout << "\033[31m" << "Shard " << i << " : " << e_msg << "\033[0m" << endl;
+		}
+		s.errors.clear();
+
+		for (uint32_t row = 0; row < s.actor.size(); ++row) {
+			if (!s.moved[row]) continue;
+			Transform& t = s.actor[row]->get_transform();
+			t.position = glm::vec2(s.x[row], s.y[row]);
+			t.rotation_deg = s.rotation[row];
+			t.mark_moved();
+		}
+
+		for (uint32_t local : s.pending_detaches) {
+			apply_detach(s, local);
+		}
+		s.pending_detaches.clear();
+
+		for (pending_attach& p : s.pending_attaches) {
+			apply_attach(s, p);
+		}
+		s.pending_attaches.clear();
+
+		for (published_event& e : s.events) {
+			uint32_t event = Interner::get_id(e.name);
+			if (!EventDB::has_subscribers(event)) continue;
+
+			int payload_ref = LUA_NOREF;
+			if (e.payload.type != LUA_TNIL) {
+				push_value(main_state, e.payload);
+				payload_ref = luaL_ref(main_state, LUA_REGISTRYINDEX);
+			}
+			EventDB::publish(event, payload_ref);
+		}
+		s.events.clear();
+	}
+}
+
+void ShardDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	if (shards.empty()) return;
+
+	size_t instances = 0;
+	double slowest_ms = 0.0;
+	for (const shard& s : shards) {
+		instances += s.actor.size();
+		slowest_ms = std::max(slowest_ms, s.update_ms);
+	}
+	out.emplace_back("shards", static_cast<double>(shards.size()));
+	out.emplace_back("shard_instances", static_cast<double>(instances));
+	out.emplace_back("shard_messages", static_cast<double>(messages_routed));
+	out.emplace_back("shard_slowest_ms", slowest_ms);
+}
+
+
+/* ------------------------ private ------------------------ */
+
+void ShardDB::thread_main(shard* s)
+{
+	uint64_t seen = 0;
+	while (true) {
+		float dt;
+		{
+			std::unique_lock<std::mutex> lock(pool_mutex);
+			pool_wakeup.wait(lock, [seen]() { return quitting || generation != seen; });
+			if (quitting) return;
+			seen = generation;
+			dt = phase_dt;
+		}
+
+		run_shard(*s, dt);
+
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		if (--running == 0) pool_done.notify_one();
+	}
+}
+
+void ShardDB::run_shard(shard& s, float dt)
+{
+	using clock = std::chrono::steady_clock;
+	clock::time_point begin = clock::now();
+
+	for (message& m : s.inbox) {
+		auto handles = s.handles_of_actor.find(m.actor_id);
+		if (handles == s.handles_of_actor.end()) continue;
+
+		for (uint32_t handle : handles->second) {
+			lua_pushstring(s.L, m.name.c_str());
+			push_value(s.L, m.payload);
+			call(s, s.instance[s.index.row_of(handle)], "OnMessage", 2);
+		}
+	}
+	s.inbox.clear();
+
+	for (uint32_t row = 0; row < s.actor.size(); ++row) {
+		if (!s.run[row]) continue;
+
+		if (!s.started[row]) {
+			s.started[row] = 1;
+			call(s, s.instance[row], "OnStart", 0);
+		}
+
+		lua_pushnumber(s.L, dt);
+		call(s, s.instance[row], "OnUpdate", 1);
+	}
+
+	s.update_ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+}
+
+bool ShardDB::call(shard& s, int instance_ref, const char* function, int extra_args)
+{
+	//(args...) -> (function, self, args...)
+	lua_rawgeti(s.L, LUA_REGISTRYINDEX, instance_ref);
+	lua_getfield(s.L, -1, function);
+	if (!lua_isfunction(s.L, -1)) {
+		lua_pop(s.L, 2 + extra_args);
+		return false;
+	}
+	lua_insert(s.L, -(2 + extra_args));
+	lua_insert(s.L, -(1 + extra_args));
+
+	if (lua_pcall(s.L, 1 + extra_args, 0, 0) != LUA_OK) {
+		s.errors.emplace_back(lua_tostring(s.L, -1));
+		lua_pop(s.L, 1);
+		return false;
+	}
+	return true;
+}
+
+uint32_t ShardDB::attach(uint32_t type_id, Actor* a, LuaRef& comp)
+{
+	uint32_t index = static_cast<uint32_t>(a->id) % shards.size();
+	shard& s = shards[index];
+
+	uint32_t local;
+	if (!s.free_handles.empty()) {
+		local = s.free_handles.back();
+		s.free_handles.pop_back();
+	}
+	else {
+		local = s.next_handle++;
+	}
+
+	pending_attach p = { local, a, type_id, LUA_NOREF, value() };
+
+	//the instance's values, then its template's, down to the prototype; nearer tables win
+	lua_State* L = comp.state();
+	comp.push(L);
+	p.main_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	p.fields.type = LUA_TTABLE;
+	std::unordered_set<std::string> seen;
+	comp.push(L);
+	for (int depth = 0; depth < MAX_VALUE_DEPTH && lua_istable(L, -1); ++depth) {
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			if (lua_type(L, -2) == LUA_TSTRING && seen.insert(lua_tostring(L, -2)).second) {
+				value v;
+				read_value(L, -1, v);
+				if (v.type != LUA_TNIL) {
+					p.fields.keys.emplace_back();
+					read_value(L, -2, p.fields.keys.back());
+					p.fields.values.push_back(std::move(v));
+				}
+			}
+			lua_pop(L, 1);
+		}
+
+		if (!lua_getmetatable(L, -1)) break;
+		lua_getfield(L, -1, "__index");
+		lua_remove(L, -2);
+		lua_remove(L, -2);
+	}
+	lua_pop(L, 1);
+
+	if (phase_active) s.pending_attaches.push_back(std::move(p));
+	else apply_attach(s, p);
+
+	return local << SHARD_BITS | index;
+}
+
+void ShardDB::detach(uint32_t handle)
+{
+	shard& s = shards[handle & (MAX_SHARDS - 1)];
+	uint32_t local = handle >> SHARD_BITS;
+
+	if (!phase_active) {
+		apply_detach(s, local);
+		return;
+	}
+
+	//attached and detached within one pass: it never reached the shard
+	for (size_t i = 0; i < s.pending_attaches.size(); ++i) {
+		if (s.pending_attaches[i].handle != local) continue;
+
+		luaL_unref(ComponentDB::get_state(), LUA_REGISTRYINDEX, s.pending_attaches[i].main_ref);
+		s.pending_attaches.erase(s.pending_attaches.begin() + i);
+		s.free_handles.push_back(local);
+		return;
+	}
+	s.pending_detaches.push_back(local);
+}
+
+void ShardDB::apply_attach(shard& s, pending_attach& p)
+{
+	load_type(s, p.type_id);
+	lua_State* L = s.L;
+
+	//instance = setmetatable(fields, { __index = type table })
+	push_value(L, p.fields);
+	lua_pushinteger(L, p.actor->id);
+	lua_setfield(L, -2, "actor_id");
+	lua_pushinteger(L, p.handle);
+	lua_setfield(L, -2, "shard_handle");
+
+	lua_newtable(L);
+	lua_getglobal(L, Interner::get_string(p.type_id).c_str());
+	lua_setfield(L, -2, "__index");
+	lua_setmetatable(L, -2);
+
+	s.index.add(p.handle);
+	s.instance.push_back(luaL_ref(L, LUA_REGISTRYINDEX));
+	s.main_ref.push_back(p.main_ref);
+	s.actor.push_back(p.actor);
+	s.run.push_back(0);
+	s.started.push_back(0);
+	s.x.push_back(0.f);
+	s.y.push_back(0.f);
+	s.rotation.push_back(0.f);
+	s.moved.push_back(0);
+	s.handles_of_actor[p.actor->id].push_back(p.handle);
+}
+
+void ShardDB::apply_detach(shard& s, uint32_t local)
+{
+	uint32_t row = s.index.row_of(local);
+
+	luaL_unref(s.L, LUA_REGISTRYINDEX, s.instance[row]);
+	luaL_unref(ComponentDB::get_state(), LUA_REGISTRYINDEX, s.main_ref[row]);
+
+	auto handles = s.handles_of_actor.find(s.actor[row]->id);
+	if (handles != s.handles_of_actor.end()) {
+		std::vector<uint32_t>& list = handles->second;
+		list.erase(std::remove(list.begin(), list.end(), local), list.end());
+		if (list.empty()) s.handles_of_actor.erase(handles);
+	}
+
+	s.index.remove(local);
+	swap_remove(s.instance, row);
+	swap_remove(s.main_ref, row);
+	swap_remove(s.actor, row);
+	swap_remove(s.run, row);
+	swap_remove(s.started, row);
+	swap_remove(s.x, row);
+	swap_remove(s.y, row);
+	swap_remove(s.rotation, row);
+	swap_remove(s.moved, row);
+
+	s.free_handles.push_back(local);
+}
+
+void ShardDB::load_type(shard& s, uint32_t type_id)
+{
+	if (!s.loaded_types.insert(type_id).second) return;
+
+	size_t cache_hits = 0;
+	for (const std::string& path : type_paths[type_id]) {
+		if (!ComponentDB::load_script(s.L, path, cache_hits) || lua_pcall(s.L, 0, 0, 0) != LUA_OK) {
+			cout << "problem with lua file " << Interner::get_string(type_id);
+			exit(0);
+		}
+	}
+}
+
+void ShardDB::read_value(lua_State* L, int idx, value& out, int depth)
+{
+	idx = lua_absindex(L, idx);
+	out.type = lua_type(L, idx);
+
+	switch (out.type) {
+	case LUA_TBOOLEAN:
+		out.boolean = lua_toboolean(L, idx) != 0;
+		break;
+	case LUA_TNUMBER:
+		out.number = lua_tonumber(L, idx);
+		break;
+	case LUA_TSTRING:
+		out.string = lua_tostring(L, idx);
+		break;
+	case LUA_TTABLE:
+		if (depth >= MAX_VALUE_DEPTH) {
+			out.type = LUA_TNIL;
+			break;
+		}
+		lua_pushnil(L);
+		while (lua_next(L, idx) != 0) {
+			value v;
+			read_value(L, -1, v, depth + 1);
+			if (v.type != LUA_TNIL) {
+				out.keys.emplace_back();
+				read_value(L, -2, out.keys.back(), depth + 1);
+				out.values.push_back(std::move(v));
+			}
+			lua_pop(L, 1);
+		}
+		break;
+	default:
+		//functions, userdata (actors) and threads stay in their own state
+		out.type = LUA_TNIL;
+		break;
+	}
+}
+
+void ShardDB::push_value(lua_State* L, const value& v)
+{
+	switch (v.type) {
+	case LUA_TBOOLEAN:
+		lua_pushboolean(L, v.boolean);
+		break;
+	case LUA_TNUMBER:
+		if (v.number == static_cast<double>(static_cast<lua_Integer>(v.number))) lua_pushinteger(L, static_cast<lua_Integer>(v.number));
+		else lua_pushnumber(L, v.number);
+		break;
+	case LUA_TSTRING:
+		lua_pushlstring(L, v.string.data(), v.string.size());
+		break;
+	case LUA_TTABLE:
+		lua_createtable(L, 0, static_cast<int>(v.keys.size()));
+		for (size_t i = 0; i < v.keys.size(); ++i) {
+			push_value(L, v.keys[i]);
+			push_value(L, v.values[i]);
+			lua_rawset(L, -3);
+		}
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+}
+
+void ShardDB::route(message& m)
+{
+	shards[static_cast<uint32_t>(m.actor_id) % shards.size()].inbox.push_back(std::move(m));
+	++messages_routed;
+}
+
+int ShardDB::lua_main_send(lua_State* L)
+{
+	if (shards.empty()) return 0;
+
+	message m;
+	if (lua_isuserdata(L, 1)) m.actor_id = luabridge::Stack<Actor*>::get(L, 1)->id;
+	else m.actor_id = static_cast<int>(luaL_checkinteger(L, 1));
+	m.name = luaL_checkstring(L, 2);
+	read_value(L, 3, m.payload);
+
+	main_outbox.push_back(std::move(m));
+	return 0;
+}
+
+uint32_t ShardDB::row_of_self(lua_State* L, shard& s)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_getfield(L, 1, "shard_handle");
+	lua_Integer handle = luaL_checkinteger(L, -1);
+	lua_pop(L, 1);
+
+	uint32_t row = s.index.row_of(static_cast<uint32_t>(handle));
+	if (row == DenseIndex::NONE) luaL_error(L, "component is not attached to this shard");
+	return row;
+}
+
+int ShardDB::lua_get_position(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+	uint32_t row = row_of_self(L, s);
+	lua_pushnumber(L, s.x[row]);
+	lua_pushnumber(L, s.y[row]);
+	return 2;
+}
+
+int ShardDB::lua_set_position(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+	uint32_t row = row_of_self(L, s);
+	s.x[row] = static_cast<float>(luaL_checknumber(L, 2));
+	s.y[row] = static_cast<float>(luaL_checknumber(L, 3));
+	s.moved[row] = 1;
+	return 0;
+}
+
+int ShardDB::lua_get_rotation(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+	lua_pushnumber(L, s.rotation[row_of_self(L, s)]);
+	return 1;
+}
+
+int ShardDB::lua_set_rotation(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+	uint32_t row = row_of_self(L, s);
+	s.rotation[row] = static_cast<float>(luaL_checknumber(L, 2));
+	s.moved[row] = 1;
+	return 0;
+}
+
+int ShardDB::lua_shard_send(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+
+	message m;
+	m.actor_id = static_cast<int>(luaL_checkinteger(L, 1));
+	m.name = luaL_checkstring(L, 2);
+	read_value(L, 3, m.payload);
+	s.outbox.push_back(std::move(m));
+	return 0;
+}
+
+int ShardDB::lua_shard_publish(lua_State* L)
+{
+	shard& s = *static_cast<shard*>(lua_touserdata(L, lua_upvalueindex(1)));
+
+	published_event e;
+	e.name = luaL_checkstring(L, 1);
+	read_value(L, 2, e.payload);
+	s.events.push_back(std::move(e));
+	return 0;
+}
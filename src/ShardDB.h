@@ -0,0 +1,160 @@
+#ifndef SHARD_DB_H
+#define SHARD_DB_H
+
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "ComponentStore.h"
+#include "LuaAllocator.h"
+
+class Actor;
+
+//opt-in parallel scripting: component types whose table sets parallel = true run in worker lua states (shards) instead
+//of the main one. each shard owns the actors whose id maps to it and has a thread that runs their OnStart / OnUpdate
+//while the main state runs its own update pass. shards share nothing with the rest of the game: they read a transform
+//snapshot and write transforms back after the pass, and reach other actors through Shard.Send (OnMessage on the
+//target's parallel components) and Shard.Publish (the Event bus on the main state)
+class ShardDB
+{
+public:
+	//starts count shards and their threads (game.config "script_shards"); without it parallel types run on the main state
+	static void init(int count);
+	static void deinit();
+	static bool is_enabled() { return !shards.empty(); }
+
+	//registers the main state's Shard namespace
+	static void add_functions(lua_State* state);
+
+	//after type's files ran on the main state: turns it into a shard type if its table has parallel = true
+	static void register_if_parallel(lua_State* state, const std::string& type, const std::vector<std::string>& paths);
+
+	//routes messages, snapshots transforms and starts the shard threads; they run alongside the main update pass
+	static void begin_update(float dt);
+	//waits for the shards, then applies transform writes, deferred attaches and detaches, and published events
+	static void end_update();
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	static constexpr uint32_t SHARD_BITS = 8;		//global handle = local handle << SHARD_BITS | shard
+	static constexpr int MAX_SHARDS = 1 << SHARD_BITS;
+	static constexpr int MAX_VALUE_DEPTH = 8;
+
+	//a lua value copied out of one state into another: nil, boolean, number, string, or a table of those
+	struct value {
+		int type = LUA_TNIL;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<value> keys;
+		std::vector<value> values;
+	};
+
+	struct message {
+		int actor_id;
+		std::string name;
+		value payload;
+	};
+
+	struct published_event {
+		std::string name;
+		value payload;
+	};
+
+	//attach requested while the shard threads were running; applied in end_update
+	struct pending_attach {
+		uint32_t handle;
+		Actor* actor;
+		uint32_t type_id;
+		int main_ref;
+		value fields;
+	};
+
+	struct shard {
+		lua_State* L = nullptr;
+		LuaAllocator allocator;
+		std::unordered_set<uint32_t> loaded_types;
+
+		//handles are handed out on the main thread; rows only change while the thread is idle
+		std::vector<uint32_t> free_handles;
+		uint32_t next_handle = 0;
+		DenseIndex index;									//local handle -> row
+		std::unordered_map<int, std::vector<uint32_t>> handles_of_actor;
+
+		std::vector<int> instance;			//registry ref in L
+		std::vector<int> main_ref;			//registry ref of the component table in the main state
+		std::vector<Actor*> actor;
+		std::vector<uint8_t> run;			//enabled, on an active, started, awake actor this frame
+		std::vector<uint8_t> started;
+		std::vector<float> x;				//local transform: snapshot in, written values out
+		std::vector<float> y;
+		std::vector<float> rotation;
+		std::vector<uint8_t> moved;
+
+		std::vector<pending_attach> pending_attaches;
+		std::vector<uint32_t> pending_detaches;
+
+		std::vector<message> inbox;			//OnMessage, before this frame's updates
+		std::vector<message> outbox;		//Shard.Send from this shard
+		std::vector<published_event> events;	//Shard.Publish from this shard
+		std::vector<std::string> errors;	//printed by the main thread
+
+		std::thread thread;
+		double update_ms = 0.0;
+	};
+
+	static inline std::deque<shard> shards;		//deque so the shard pointers given to threads and lua stay put
+	static inline std::unordered_map<uint32_t, std::vector<std::string>> type_paths;
+	static inline std::vector<message> main_outbox;		//Shard.Send from the main state
+	static inline size_t messages_routed = 0;
+
+	//thread pool: begin_update bumps generation, each shard thread runs once per generation
+	static inline std::mutex pool_mutex;
+	static inline std::condition_variable pool_wakeup;
+	static inline std::condition_variable pool_done;
+	static inline uint64_t generation = 0;
+	static inline size_t running = 0;
+	static inline bool quitting = false;
+	static inline bool phase_active = false;
+	static inline float phase_dt = 0.f;
+
+	static void thread_main(shard* s);
+	static void run_shard(shard& s, float dt);
+	static bool call(shard& s, int instance_ref, const char* function, int extra_args);
+
+	static uint32_t attach(uint32_t type_id, Actor* a, luabridge::LuaRef& comp);
+	static void detach(uint32_t handle);
+	static void apply_attach(shard& s, pending_attach& p);
+	static void apply_detach(shard& s, uint32_t local);
+	static void load_type(shard& s, uint32_t type_id);
+
+	static void read_value(lua_State* L, int idx, value& out, int depth = 0);
+	static void push_value(lua_State* L, const value& v);
+	static void route(message& m);
+
+	//lua, main state: Shard.Send(actor or actor id, name, [payload])
+	static int lua_main_send(lua_State* L);
+
+	//lua, shard states (shard as upvalue 1): Shard.GetPosition(self), Shard.SetPosition(self, x, y),
+	//Shard.GetRotation(self), Shard.SetRotation(self, degrees), Shard.Send(actor id, name, [payload]), Shard.Publish(name, [payload])
+	static int lua_get_position(lua_State* L);
+	static int lua_set_position(lua_State* L);
+	static int lua_get_rotation(lua_State* L);
+	static int lua_set_rotation(lua_State* L);
+	static int lua_shard_send(lua_State* L);
+	static int lua_shard_publish(lua_State* L);
+	static uint32_t row_of_self(lua_State* L, shard& s);
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "SpatialGrid.h"
+#include "Actor.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+void SpatialGrid::insert(Actor* a, const glm::ivec2& cell)
+{
+	cells[cell].push_back(a);
+	++count;
+}
+
+void SpatialGrid::remove(Actor* a, const glm::ivec2& cell)
+{
+	auto it = cells.find(cell);
+	if (it == cells.end()) return;
+
+	//order within a cell doesn't matter, so swap and pop
+	std::vector<Actor*>& bucket = it->second;
+	auto pos = std::find(bucket.begin(), bucket.end(), a);
+	if (pos == bucket.end()) return;
+
+	*pos = bucket.back();
+	bucket.pop_back();
+	--count;
+
+	if (bucket.empty())
+		cells.erase(it);
+}
+
+void SpatialGrid::move(Actor* a, const glm::ivec2& from, const glm::ivec2& to)
+{
+	if (from == to) return;
+
+	remove(a, from);
+	insert(a, to);
+}
+
+const std::vector<Actor*>* SpatialGrid::get_cell(const glm::ivec2& cell) const
+{
+	auto it = cells.find(cell);
+	if (it == cells.end()) return nullptr;
+	return &it->second;
+}
+
+void SpatialGrid::query_rect(const glm::vec2& min, const glm::vec2& max, std::vector<Actor*>& out) const
+{
+	auto test = [&](const std::vector<Actor*>& bucket) {
+		for (Actor* a : bucket) {
+			const glm::vec2& p = a->get_position();
+			if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y)
+				out.push_back(a);
+		}
+	};
+
+	for_each_cell_in(cell_of(min), cell_of(max), test);
+}
+
+void SpatialGrid::query_radius(const glm::vec2& center, float radius, std::vector<Actor*>& out) const
+{
+	float r2 = radius * radius;
+
+	auto test = [&](const std::vector<Actor*>& bucket) {
+		for (Actor* a : bucket) {
+			glm::vec2 d = a->get_position() - center;
+			if (glm::dot(d, d) <= r2)
+				out.push_back(a);
+		}
+	};
+
+	for_each_cell_in(cell_of(center - radius), cell_of(center + radius), test);
+}
+
+void SpatialGrid::nearest(const glm::vec2& center, size_t k, std::vector<Actor*>& out) const
+{
+	if (k == 0 || count == 0) return;
+
+	//max heap on squared distance holding the best k so far
+	using candidate = std::pair<float, Actor*>;
+	std::priority_queue<candidate> best;
+
+	auto consider = [&](const std::vector<Actor*>& bucket) {
+		for (Actor* a : bucket) {
+			//destroyed this frame but still indexed until release_destroyed; must not take a slot from a live actor
+			if (!a->is_active()) continue;
+
+			glm::vec2 d = a->get_position() - center;
+			float dist2 = glm::dot(d, d);
+			if (best.size() < k) best.emplace(dist2, a);
+			else if (dist2 < best.top().first) {
+				best.pop();
+				best.emplace(dist2, a);
+			}
+		}
+	};
+
+	glm::ivec2 origin = cell_of(center);
+	size_t visited_cells = 0;
+
+	//walk square rings outward; after ring r every unvisited actor is at least r * cell_size away
+	for (int r = 0; ; ++r) {
+		//sparse grid with far outliers: cheaper to scan the occupied cells directly
+		if (visited_cells > cells.size() * 2) {
+			while (!best.empty()) best.pop();
+			for (const auto& cell : cells) consider(cell.second);
+			break;
+		}
+
+		for (int x = origin.x - r; x <= origin.x + r; ++x) {
+			bool edge_col = (x == origin.x - r || x == origin.x + r);
+			for (int y = origin.y - r; y <= origin.y + r; y += (edge_col || r == 0) ? 1 : 2 * r) {
+				++visited_cells;
+				const std::vector<Actor*>* bucket = get_cell(glm::ivec2(x, y));
+				if (bucket != nullptr) consider(*bucket);
+			}
+		}
+
+		//with inactive actors in the grid fewer than min(k, count) may exist; the full scan above then ends the walk
+		float bound = r * cell_size;
+		if (best.size() == std::min(k, count) && best.top().first <= bound * bound)
+			break;
+	}
+
+	size_t first = out.size();
+	out.resize(first + best.size());
+	for (size_t i = out.size(); i > first; --i) {
+		out[i - 1] = best.top().second;
+		best.pop();
+	}
+}
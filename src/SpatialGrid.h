@@ -0,0 +1,78 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+
+class Actor;
+
+//uniform grid over world space that buckets actors by cell; empty cells are not stored
+class SpatialGrid
+{
+public:
+	SpatialGrid(float cell_size = 4.f) : cell_size(cell_size) {}
+
+	glm::ivec2 cell_of(const glm::vec2& pos) const {
+		return glm::ivec2(static_cast<int>(std::floor(pos.x / cell_size)), static_cast<int>(std::floor(pos.y / cell_size)));
+	}
+
+	void insert(Actor* a, const glm::ivec2& cell);
+	void remove(Actor* a, const glm::ivec2& cell);
+	void move(Actor* a, const glm::ivec2& from, const glm::ivec2& to);
+
+	//actors in cell, or nullptr if the cell is empty
+	const std::vector<Actor*>* get_cell(const glm::ivec2& cell) const;
+
+	/* queries test the actor's current position against the shape; out is appended to */
+	//actors inside the axis aligned box [min, max]
+	void query_rect(const glm::vec2& min, const glm::vec2& max, std::vector<Actor*>& out) const;
+	//actors within radius of center
+	void query_radius(const glm::vec2& center, float radius, std::vector<Actor*>& out) const;
+	//up to k active actors closest to center, nearest first
+	void nearest(const glm::vec2& center, size_t k, std::vector<Actor*>& out) const;
+
+	void clear() { cells.clear(); count = 0; }
+
+	size_t size() const { return count; }
+	size_t cell_count() const { return cells.size(); }
+
+	float get_cell_size() const { return cell_size; }
+	void set_cell_size(float size) { cell_size = size; }
+
+private:
+	struct cell_hash {
+		size_t operator()(const glm::ivec2& c) const {
+			return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) | static_cast<uint32_t>(c.y));
+		}
+	};
+
+	//calls f(bucket) for each occupied cell in [lo, hi]; walks the occupied cells instead when that is smaller than the range
+	template<typename F>
+	void for_each_cell_in(const glm::ivec2& lo, const glm::ivec2& hi, F&& f) const {
+		double range = (static_cast<double>(hi.x) - lo.x + 1) * (static_cast<double>(hi.y) - lo.y + 1);
+		if (range > static_cast<double>(cells.size())) {
+			for (const auto& cell : cells) {
+				if (cell.first.x >= lo.x && cell.first.x <= hi.x && cell.first.y >= lo.y && cell.first.y <= hi.y)
+					f(cell.second);
+			}
+			return;
+		}
+
+		for (int x = lo.x; x <= hi.x; ++x) {
+			for (int y = lo.y; y <= hi.y; ++y) {
+				auto it = cells.find(glm::ivec2(x, y));
+				if (it != cells.end()) f(it->second);
+			}
+		}
+	}
+
+	std::unordered_map<glm::ivec2, std::vector<Actor*>, cell_hash> cells;
+	float cell_size;
+	size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "StartupGraph.h"
+
+#include "SDL2/SDL.h"
+
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+using std::cout;
+using std::endl;
+
+size_t StartupGraph::add(const std::string& name, Affinity affinity, std::function<void()> work, const std::vector<size_t>& deps)
+{
+	size_t index = tasks.size();
+	tasks.push_back({ name, affinity, std::move(work), {}, 0, 0, 0 });
+
+	for (size_t dep : deps) {
+		if (dep >= index) {
+			cout << "error: startup task " << name << " depends on a task added after it";
+			exit(0);
+		}
+		tasks[dep].dependents.push_back(index);
+		++tasks[index].waiting_on;
+	}
+	return index;
+}
+
+void StartupGraph::run()
+{
+	run_begin = SDL_GetPerformanceCounter();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (size_t t = 0; t < tasks.size(); ++t) {
+		if (tasks[t].waiting_on == 0) dispatch(t);
+	}
+
+	while (finished < tasks.size()) {
+		main_wakeup.wait(lock, [this]() { return !ready_main.empty() || finished == tasks.size(); });
+		if (ready_main.empty()) break;
+
+		size_t t = ready_main.front();
+		ready_main.pop_front();
+
+		lock.unlock();
+		tasks[t].begin = SDL_GetPerformanceCounter();
+		tasks[t].work();
+		tasks[t].end = SDL_GetPerformanceCounter();
+		lock.lock();
+
+		finish(t);
+	}
+	lock.unlock();
+
+	//every task is done; the threads are finishing their last few instructions
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+
+	run_end = SDL_GetPerformanceCounter();
+}
+
+void StartupGraph::print_timeline() const
+{
+	const int BAR_WIDTH = 40;
+
+	double freq = static_cast<double>(SDL_GetPerformanceFrequency());
+	double total_ms = (run_end - run_begin) * 1000.0 / freq;
+
+	std::vector<size_t> order(tasks.size());
+	for (size_t t = 0; t < tasks.size(); ++t) order[t] = t;
+	std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return tasks[a].begin < tasks[b].begin; });
+
+	double busy_ms = 0.0;
+	cout << "---- startup timeline (" << std::fixed << std::setprecision(1) << total_ms << " ms) ----" << endl;
+	for (size_t t : order) {
+		double begin_ms = (tasks[t].begin - run_begin) * 1000.0 / freq;
+		double end_ms = (tasks[t].end - run_begin) * 1000.0 / freq;
+		busy_ms += end_ms - begin_ms;
+
+		int bar_begin = total_ms > 0.0 ? static_cast<int>(begin_ms / total_ms * BAR_WIDTH) : 0;
+		int bar_end = total_ms > 0.0 ? static_cast<int>(end_ms / total_ms * BAR_WIDTH) : 0;
+		bar_end = std::min(BAR_WIDTH, std::max(bar_end, bar_begin + 1));
+
+		cout << std::left << std::setw(18) << tasks[t].name << std::setw(8) << (tasks[t].affinity == MAIN ? "main" : "worker")
+			<< std::right << std::setw(8) << begin_ms << " -" << std::setw(8) << end_ms << " ms  |"
+			<< std::string(bar_begin, ' ') << std::string(bar_end - bar_begin, '#') << std::string(BAR_WIDTH - bar_end, ' ') << "|" << endl;
+	}
+	cout << "serial time " << busy_ms << " ms, overlapped to " << total_ms << " ms" << endl;
+	cout.unsetf(std::ios::floatfield);
+	cout << std::setprecision(6);
+}
+
+
+/* ------------------------ private ------------------------ */
+
+void StartupGraph::dispatch(size_t t)
+{
+	if (tasks[t].affinity == MAIN) {
+		ready_main.push_back(t);
+		main_wakeup.notify_one();
+		return;
+	}
+
+	workers.emplace_back([this, t]() {
+		tasks[t].begin = SDL_GetPerformanceCounter();
+		tasks[t].work();
+		tasks[t].end = SDL_GetPerformanceCounter();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finish(t);
+	});
+}
+
+void StartupGraph::finish(size_t t)
+{
+	++finished;
+	for (size_t dependent : tasks[t].dependents) {
+		if (--tasks[dependent].waiting_on == 0) dispatch(dependent);
+	}
+	if (finished == tasks.size()) main_wakeup.notify_one();
+}
@@ -0,0 +1,57 @@
+#ifndef STARTUP_GRAPH_H
+#define STARTUP_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+//engine startup as a small dependency graph: a worker task (file reads, decoding, compiling) gets its own thread as soon
+//as its dependencies finish; main tasks (SDL init, the renderer, the lua state, engine settings and anything that may
+//exit) run on the thread that called run()
+class StartupGraph
+{
+public:
+	enum Affinity { MAIN, WORKER };
+
+	//returns the task's index, for use in later tasks' dependencies
+	size_t add(const std::string& name, Affinity affinity, std::function<void()> work, const std::vector<size_t>& deps = {});
+
+	//runs every task and returns once all have finished
+	void run();
+
+	//one row per task in start order: where it ran and when, relative to run()
+	void print_timeline() const;
+
+private:
+	struct task {
+		std::string name;
+		Affinity affinity;
+		std::function<void()> work;
+		std::vector<size_t> dependents;
+		size_t waiting_on = 0;		//unfinished dependencies
+		uint64_t begin = 0;
+		uint64_t end = 0;
+	};
+
+	std::vector<task> tasks;
+
+	std::mutex mutex;
+	std::condition_variable main_wakeup;
+	std::deque<size_t> ready_main;
+	std::vector<std::thread> workers;
+	size_t finished = 0;
+
+	uint64_t run_begin = 0;
+	uint64_t run_end = 0;
+
+	//with mutex held
+	void dispatch(size_t t);
+	void finish(size_t t);
+};
+
+#endif
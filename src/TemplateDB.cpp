@@ -60,7 +60,8 @@ Actor* TemplateDB::create_template(std::string template_name)
 	if (d.HasMember("template") && d["template"].IsString())
 		temp = create_template(d["template"].GetString());
 
-	templates.emplace(template_name, Actor(d, true));
+	//construct in place: components hold pointers to their actor and its Transform
+	templates.try_emplace(template_name, d, true);
 
 	return &templates[template_name];
 }
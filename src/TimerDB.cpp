@@ -0,0 +1,272 @@
+#include "TimerDB.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "Profiler.h"
+#include "Interner.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void TimerDB::add_functions(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Timer")
+		.addFunction("After", &TimerDB::lua_after)
+		.addFunction("Every", &TimerDB::lua_every)
+		.addFunction("Cancel", &TimerDB::lua_cancel)
+		.endNamespace();
+}
+
+void TimerDB::update(float now)
+{
+	fired_last_frame = 0;
+
+	uint64_t target = to_ticks(now);
+	if (live_timers == 0) {
+		current_tick = std::max(current_tick, target);
+		return;
+	}
+
+	//walk the ticks we skipped; most frames that is ~16 slot heads, nearly all empty
+	expired.clear();
+	while (current_tick < target) {
+		++current_tick;
+
+		//a level's slot comes up whenever every lower level wraps around
+		for (int level = 1; level < LEVELS; ++level) {
+			if ((current_tick & ((1ull << (LEVEL_BITS * level)) - 1)) != 0) break;
+			cascade(level);
+		}
+
+		uint32_t& head = slots[current_tick & (SLOTS - 1)];
+		while (head != NONE) {
+			uint32_t idx = head;
+			unlink(idx);
+			timers[idx].state = STATE_FIRING;
+			expired.push_back(idx);
+		}
+	}
+
+	if (expired.empty()) return;
+
+	lua_State* L = ComponentDB::get_state();
+	std::vector<uint32_t> firing;
+	firing.swap(expired);
+	for (uint32_t idx : firing) {
+		if (!timers[idx].cancelled) {
+			static const uint32_t TIMER_TYPE = Interner::get_id("Timer");
+			Profiler::zone zone(TIMER_TYPE, "Timer", timers[idx].owner);
+			Actor::running_scope running(timers[idx].owner);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, timers[idx].fn_ref);
+			if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+				std::string e_msg = lua_tostring(L, -1);
+				std::replace(e_msg.begin(), e_msg.end(), '\\', '/');
+				cout << "\033[31m" << "Timer : " << e_msg << "\033[0m" << endl;
+				lua_pop(L, 1);
+			}
+			++fired_last_frame;
+		}
+
+		//timers is not touched by reference across the call since callbacks can add timers (and grow it)
+		timer& t = timers[idx];
+		if (t.cancelled || t.interval == 0) {
+			free_timer(idx);
+			continue;
+		}
+
+		//repeating: next period, but never back into a tick we already passed
+		t.expires = std::max(t.expires + t.interval, current_tick + 1);
+		link(idx);
+	}
+}
+
+void TimerDB::release(Actor* a)
+{
+	auto it = owned.find(a);
+	if (it == owned.end()) return;
+
+	uint32_t idx = it->second;
+	owned.erase(it);
+
+	while (idx != NONE) {
+		uint32_t next = timers[idx].owner_next;
+		timers[idx].owner = nullptr;		//list is gone, free_timer must not touch it
+		timers[idx].owner_prev = timers[idx].owner_next = NONE;
+
+		if (timers[idx].state == STATE_WAITING) {
+			unlink(idx);
+			free_timer(idx);
+		}
+		else if (timers[idx].state == STATE_FIRING) {
+			timers[idx].cancelled = true;
+		}
+		idx = next;
+	}
+}
+
+void TimerDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("timers", static_cast<double>(live_timers));
+	out.emplace_back("timers_fired", static_cast<double>(fired_last_frame));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+int TimerDB::lua_after(lua_State* L)
+{
+	return add(L, false);
+}
+
+int TimerDB::lua_every(lua_State* L)
+{
+	return add(L, true);
+}
+
+int TimerDB::add(lua_State* L, bool repeating)
+{
+	double seconds = luaL_checknumber(L, 1);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+
+	//owner: the actor whose callback is running, or a component / actor passed explicitly; its timers go when it is destroyed
+	Actor* owner = Actor::get_running();
+	if (lua_istable(L, 3)) {
+		LuaRef actor = LuaRef::fromStack(L, 3)["actor"];
+		if (actor.isUserdata()) owner = actor.cast<Actor*>();
+	}
+	else if (lua_isuserdata(L, 3)) {
+		owner = luabridge::Stack<Actor*>::get(L, 3);
+	}
+
+	if (!slots_initialized) {
+		std::fill(std::begin(slots), std::end(slots), NONE);
+		slots_initialized = true;
+	}
+
+	uint32_t idx;
+	if (!free_timers.empty()) {
+		idx = free_timers.back();
+		free_timers.pop_back();
+	}
+	else {
+		idx = static_cast<uint32_t>(timers.size());
+		timers.emplace_back();
+	}
+
+	timer& t = timers[idx];
+	uint64_t delay = std::max<uint64_t>(to_ticks(seconds), 1);
+	t.state = STATE_WAITING;
+	t.cancelled = false;
+	t.expires = current_tick + delay;
+	t.interval = repeating ? delay : 0;
+	lua_pushvalue(L, 2);
+	t.fn_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	t.owner = owner;
+
+	if (owner != nullptr) {
+		auto head = owned.find(owner);
+		t.owner_prev = NONE;
+		t.owner_next = head != owned.end() ? head->second : NONE;
+		if (t.owner_next != NONE) timers[t.owner_next].owner_prev = idx;
+		owned[owner] = idx;
+	}
+
+	link(idx);
+	++live_timers;
+
+	lua_pushinteger(L, static_cast<lua_Integer>(make_id(idx)));
+	return 1;
+}
+
+int TimerDB::lua_cancel(lua_State* L)
+{
+	uint64_t id = static_cast<uint64_t>(luaL_checkinteger(L, 1));
+	uint32_t idx = static_cast<uint32_t>(id & 0xFFFFFFFFu);
+	if (idx >= timers.size() || timers[idx].generation != static_cast<uint32_t>(id >> 32)) return 0;
+
+	timer& t = timers[idx];
+	if (t.state == STATE_WAITING) {
+		unlink(idx);
+		free_timer(idx);
+	}
+	else if (t.state == STATE_FIRING) {
+		t.cancelled = true;
+	}
+	return 0;
+}
+
+uint64_t TimerDB::to_ticks(double seconds)
+{
+	if (seconds <= 0.0) return 0;
+	return static_cast<uint64_t>(std::ceil(seconds / TICK_SECONDS - 1e-6));
+}
+
+void TimerDB::link(uint32_t idx)
+{
+	timer& t = timers[idx];
+	uint64_t delta = std::min(t.expires - current_tick, MAX_DELAY);
+	uint64_t when = current_tick + delta;
+
+	//the first level whose span covers the delay
+	int level = 0;
+	while (level < LEVELS - 1 && delta >= (1ull << (LEVEL_BITS * (level + 1)))) ++level;
+
+	uint32_t slot = static_cast<uint32_t>(level * SLOTS + ((when >> (LEVEL_BITS * level)) & (SLOTS - 1)));
+	t.slot = slot;
+	t.state = STATE_WAITING;
+	t.prev = NONE;
+	t.next = slots[slot];
+	if (t.next != NONE) timers[t.next].prev = idx;
+	slots[slot] = idx;
+}
+
+void TimerDB::unlink(uint32_t idx)
+{
+	timer& t = timers[idx];
+	if (t.prev != NONE) timers[t.prev].next = t.next;
+	else slots[t.slot] = t.next;
+	if (t.next != NONE) timers[t.next].prev = t.prev;
+
+	t.prev = t.next = NONE;
+	t.slot = NONE;
+}
+
+void TimerDB::cascade(int level)
+{
+	uint32_t slot = static_cast<uint32_t>(level * SLOTS + ((current_tick >> (LEVEL_BITS * level)) & (SLOTS - 1)));
+
+	//everything here is now within reach of a lower level
+	uint32_t idx = slots[slot];
+	slots[slot] = NONE;
+	while (idx != NONE) {
+		uint32_t next = timers[idx].next;
+		link(idx);
+		idx = next;
+	}
+}
+
+void TimerDB::free_timer(uint32_t idx)
+{
+	timer& t = timers[idx];
+	luaL_unref(ComponentDB::get_state(), LUA_REGISTRYINDEX, t.fn_ref);
+
+	if (t.owner != nullptr) {
+		if (t.owner_prev != NONE) timers[t.owner_prev].owner_next = t.owner_next;
+		else if (t.owner_next != NONE) owned[t.owner] = t.owner_next;
+		else owned.erase(t.owner);
+		if (t.owner_next != NONE) timers[t.owner_next].owner_prev = t.owner_prev;
+	}
+
+	uint32_t generation = t.generation + 1;
+	t = timer();
+	t.generation = generation;
+	free_timers.push_back(idx);
+	--live_timers;
+}
@@ -0,0 +1,85 @@
+#ifndef TIMER_DB_H
+#define TIMER_DB_H
+
+#include "Lua/lua.hpp"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//Timer.After / Timer.Every callbacks kept in a hierarchical timing wheel: four levels of 64 slots over 1ms ticks.
+//adding and cancelling unlink / link one node, each tick looks at a single level 0 slot and timers further out
+//cascade down a level only when their slot comes up
+class TimerDB
+{
+public:
+	static inline const float TICK_SECONDS = 0.001f;
+
+	//registers the Timer namespace
+	static void add_functions(lua_State* state);
+
+	//advances the wheel to now (seconds since the scene started) and runs every timer that expired on the way
+	static void update(float now);
+
+	//cancels a's timers (SceneDB::cpp_destroy)
+	static void release(Actor* a);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	static inline const uint32_t NONE = UINT32_MAX;
+	static inline const int LEVEL_BITS = 6;
+	static inline const int SLOTS = 1 << LEVEL_BITS;
+	static inline const int LEVELS = 4;
+	static inline const uint64_t MAX_DELAY = (1ull << (LEVEL_BITS * LEVELS)) - 1;	//in ticks, ~4.6 hours
+
+	static inline const uint8_t STATE_FREE = 0;
+	static inline const uint8_t STATE_WAITING = 1;	//linked into a slot
+	static inline const uint8_t STATE_FIRING = 2;	//expired this update, callback pending
+
+	struct timer {
+		uint32_t prev = NONE;			//slot list
+		uint32_t next = NONE;
+		uint32_t owner_prev = NONE;		//owner's list
+		uint32_t owner_next = NONE;
+		uint32_t slot = NONE;			//index into slots
+		uint32_t generation = 0;		//bumped on free so stale ids miss
+		uint8_t state = STATE_FREE;
+		bool cancelled = false;			//cancelled while firing
+		uint64_t expires = 0;			//tick
+		uint64_t interval = 0;			//ticks, 0 for one shot
+		int fn_ref = LUA_NOREF;
+		Actor* owner = nullptr;
+	};
+
+	static inline std::vector<timer> timers;
+	static inline std::vector<uint32_t> free_timers;
+	static inline uint32_t slots[LEVELS * SLOTS];			//list heads
+	static inline bool slots_initialized = false;
+	static inline std::unordered_map<Actor*, uint32_t> owned;	//owner -> first timer in its list
+
+	static inline uint64_t current_tick = 0;
+	static inline std::vector<uint32_t> expired;
+	static inline size_t live_timers = 0;
+	static inline size_t fired_last_frame = 0;
+
+	//lua: id = Timer.After(seconds, fn, [owner]), id = Timer.Every(seconds, fn, [owner]), Timer.Cancel(id)
+	static int lua_after(lua_State* L);
+	static int lua_every(lua_State* L);
+	static int lua_cancel(lua_State* L);
+	static int add(lua_State* L, bool repeating);
+
+	static uint64_t to_ticks(double seconds);
+	static void link(uint32_t idx);
+	static void unlink(uint32_t idx);
+	static void cascade(int level);
+	static void free_timer(uint32_t idx);
+
+	static uint64_t make_id(uint32_t idx) { return (static_cast<uint64_t>(timers[idx].generation) << 32) | idx; }
+};
+
+#endif
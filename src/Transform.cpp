@@ -1,9 +1,12 @@
 #include "Transform.h"
 #include "Renderer.h"
+#include "SceneDB.h"
 
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <cmath>
+#include <algorithm>
 
 using std::cout;
 using std::endl;
@@ -69,3 +72,204 @@ int Transform::read_json(const rapidjson::Value& obj)
 
 	return idx;
 }
+
+
+void Transform::set_parent(Transform* new_parent, bool keep_world)
+{
+	if (new_parent == parent) return;
+
+	for (Transform* p = new_parent; p != nullptr; p = p->parent) {
+		if (p == this) {
+			cout << "error: tried to parent a transform to itself or one of its children";
+			exit(0);
+		}
+	}
+
+	glm::mat3 old_world = in_hierarchy() ? (refresh(), world) : local_matrix();
+
+	Transform* old_parent = parent;
+	bool was_member = in_hierarchy();
+	bool new_parent_was_member = new_parent != nullptr && new_parent->in_hierarchy();
+
+	if (old_parent != nullptr) {
+		auto it = std::find(old_parent->children.begin(), old_parent->children.end(), this);
+		if (it != old_parent->children.end()) old_parent->children.erase(it);
+	}
+	parent = new_parent;
+	if (new_parent != nullptr)
+		new_parent->children.push_back(this);
+
+	update_membership(was_member);
+	if (old_parent != nullptr) old_parent->update_membership(true);
+	if (new_parent != nullptr) new_parent->update_membership(new_parent_was_member);
+
+	if (keep_world) {
+		glm::mat3 local = old_world;
+		if (new_parent != nullptr) {
+			new_parent->refresh();
+			local = glm::inverse(new_parent->world) * old_world;
+		}
+
+		position = glm::vec2(local[2]);
+		scale = glm::vec2(glm::length(glm::vec2(local[0])), glm::length(glm::vec2(local[1])));
+		if (glm::determinant(glm::mat2(local)) < 0.f) scale.y = -scale.y;
+		rotation_deg = glm::degrees(std::atan2(local[0].y, local[0].x));
+	}
+
+	parent_version = UINT32_MAX;
+	//without keep_world the subtree jumps to its new parent's frame
+	if (!keep_world) mark_moved();
+}
+
+void Transform::detach()
+{
+	while (!children.empty()) {
+		Transform* child = children.back();
+		//a child that no longer points back would never remove itself
+		if (child->parent == this) child->set_parent(nullptr, true);
+		else children.pop_back();
+	}
+	set_parent(nullptr, false);
+}
+
+void Transform::reset()
+{
+	detach();
+
+	position = { 0.f, 0.f };
+	scale = { 1.f, 1.f };
+	rotation_deg = 0.f;
+	pivot = { 0.5f, 0.5f };
+
+	world = glm::mat3(1.f);
+	cached_position = { 0.f, 0.f };
+	cached_scale = { 1.f, 1.f };
+	cached_rotation = 0.f;
+	++version;
+	parent_version = UINT32_MAX;
+}
+
+glm::vec2 Transform::get_world_position() const
+{
+	if (!in_hierarchy()) return position;
+
+	refresh();
+	return glm::vec2(world[2]);
+}
+
+glm::vec2 Transform::get_world_scale() const
+{
+	if (!in_hierarchy()) return scale;
+
+	refresh();
+	return glm::vec2(glm::length(glm::vec2(world[0])), glm::length(glm::vec2(world[1])));
+}
+
+float Transform::get_world_rotation() const
+{
+	if (!in_hierarchy()) return rotation_deg;
+
+	refresh();
+	return glm::degrees(std::atan2(world[0].y, world[0].x));
+}
+
+void Transform::set_world_position(float x, float y)
+{
+	if (parent == nullptr) {
+		position = glm::vec2(x, y);
+	}
+	else {
+		parent->refresh();
+		position = glm::vec2(glm::inverse(parent->world) * glm::vec3(x, y, 1.f));
+	}
+	mark_moved();
+}
+
+void Transform::mark_moved()
+{
+	if (owner != nullptr) SceneDB::mark_moved(owner);
+	for (Transform* child : children) {
+		child->mark_moved();
+	}
+}
+
+glm::vec2 Transform::transform_point(float x, float y) const
+{
+	glm::mat3 m = in_hierarchy() ? (refresh(), world) : local_matrix();
+	return glm::vec2(m * glm::vec3(x, y, 1.f));
+}
+
+void Transform::update_hierarchy()
+{
+	if (order_dirty) {
+		order.clear();
+		for (Transform* t : members) {
+			if (t->parent == nullptr) push_subtree(t);
+		}
+		order_dirty = false;
+	}
+
+	//parents come first, so each node only has to compare itself against its parent's version
+	for (Transform* t : order) {
+		t->recompute();
+	}
+}
+
+
+/* ------------------------ private ------------------------ */
+
+void Transform::update_membership(bool was_member)
+{
+	bool is_member = in_hierarchy();
+	if (is_member == was_member) return;
+
+	if (is_member) members.push_back(this);
+	else {
+		auto it = std::find(members.begin(), members.end(), this);
+		if (it != members.end()) members.erase(it);
+	}
+	order_dirty = true;
+}
+
+glm::mat3 Transform::local_matrix() const
+{
+	float rad = glm::radians(rotation_deg);
+	float c = std::cos(rad);
+	float s = std::sin(rad);
+
+	//translate * rotate * scale
+	return glm::mat3(
+		c * scale.x, s * scale.x, 0.f,
+		-s * scale.y, c * scale.y, 0.f,
+		position.x, position.y, 1.f);
+}
+
+void Transform::refresh() const
+{
+	if (parent != nullptr) parent->refresh();
+	recompute();
+}
+
+void Transform::recompute() const
+{
+	//"dirty" means the local values moved off the snapshot (lua writes fields directly) or the parent was recomputed
+	uint32_t current_parent_version = parent != nullptr ? parent->version : 0;
+	if (position == cached_position && scale == cached_scale && rotation_deg == cached_rotation && parent_version == current_parent_version)
+		return;
+
+	cached_position = position;
+	cached_scale = scale;
+	cached_rotation = rotation_deg;
+	parent_version = current_parent_version;
+
+	world = parent != nullptr ? parent->world * local_matrix() : local_matrix();
+	++version;
+}
+
+void Transform::push_subtree(Transform* t)
+{
+	order.push_back(t);
+	for (Transform* child : t->children) {
+		push_subtree(child);
+	}
+}
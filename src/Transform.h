@@ -4,26 +4,91 @@
 #include "glm/glm.hpp"
 #include "rapidjson/document.h"
 
+#include <vector>
+#include <cstdint>
+
+class Actor;
+
 class Transform
 {
 public:
 
 	Transform() {}
 
-	void translate(float dx, float dy) { position += glm::vec2(dx, dy); }
+	//children and the hierarchy lists hold raw pointers to this transform, so it never gets copied
+	Transform(const Transform&) = delete;
+	Transform& operator=(const Transform&) = delete;
+
+	//detaches and puts every local and cached value back to a fresh transform's (pooled actors)
+	void reset();
+
+	void translate(float dx, float dy) { position += glm::vec2(dx, dy); mark_moved(); }
 	void rotate(float deg) { rotation_deg += deg; }
 	void rescale(float px, float py) { scale *= glm::vec2(px, py); }
 
 	//takes obj, the json representing the object, and idx, the idx of the "transform" property
 	int read_json(const rapidjson::Value& obj);
 
+	/* hierarchy: position / scale / rotation are relative to the parent, world values are cached until something changes */
+	//reparents this transform (nullptr detaches); keep_world keeps the current world pose by rewriting the local one
+	void set_parent(Transform* new_parent, bool keep_world);
+	void lua_set_parent(Transform* new_parent) { set_parent(new_parent, true); }
+	Transform* get_parent() const { return parent; }
+	int get_child_count() const { return static_cast<int>(children.size()); }
+
+	//detaches from the parent and all children (children keep their world pose)
+	void detach();
+
+	glm::vec2 get_world_position() const;
+	glm::vec2 get_world_scale() const;
+	float get_world_rotation() const;
+	void set_world_position(float x, float y);
+
+	//local (x, y) in world space
+	glm::vec2 transform_point(float x, float y) const;
+
+	//tells SceneDB the owner and every descendant moved, so its grids re-bucket them; the setters above call it,
+	//plain field writes (lua's position.x = ...) are caught by ComponentStore::sync_transforms instead
+	void mark_moved();
+	void set_owner(Actor* a) { owner = a; }
+
+	//recomputes world values of changed subtrees, parents before children
+	static void update_hierarchy();
+	static size_t get_hierarchy_size() { return members.size(); }
+
 	glm::vec2 position = { 0.f, 0.f };
 	glm::vec2 scale = { 1.f, 1.f };
 	float rotation_deg = 0.f;
 	glm::vec2 pivot = { 0.5f, 0.5f };
 
 private:
+	Actor* owner = nullptr;
+	Transform* parent = nullptr;
+	std::vector<Transform*> children;
+
+	//world cache, valid while the local values match the snapshot and the parent's version matches parent_version
+	mutable glm::mat3 world = glm::mat3(1.f);
+	mutable glm::vec2 cached_position = { 0.f, 0.f };
+	mutable glm::vec2 cached_scale = { 1.f, 1.f };
+	mutable float cached_rotation = 0.f;
+	mutable uint32_t version = 0;
+	mutable uint32_t parent_version = UINT32_MAX;
+
+	//transforms with a parent or children; flat ones never touch the cache
+	static inline std::vector<Transform*> members;
+	static inline std::vector<Transform*> order;		//members, each parent before its children
+	static inline bool order_dirty = false;
+
+	bool in_hierarchy() const { return parent != nullptr || !children.empty(); }
+	void update_membership(bool was_member);
+
+	glm::mat3 local_matrix() const;
+	//brings world up to date, refreshing ancestors first
+	void refresh() const;
+	//brings world up to date assuming the parent already is
+	void recompute() const;
 
+	static void push_subtree(Transform* t);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,290 @@
+#include "TweenDB.h"
+
+#include "Actor.h"
+#include "ComponentDB.h"
+#include "ComponentStore.h"
+#include "Interner.h"
+#include "Transform.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using std::cout;
+using std::endl;
+
+using luabridge::LuaRef;
+
+void TweenDB::add_functions(lua_State* state)
+{
+	luabridge::getGlobalNamespace(state)
+		.beginNamespace("Tween")
+		.addFunction("To", &TweenDB::lua_to)
+		.addFunction("Cancel", &TweenDB::lua_cancel)
+		.addFunction("IsActive", &TweenDB::lua_is_active)
+		.endNamespace();
+}
+
+void TweenDB::update(float dt)
+{
+	finished_last_frame = 0;
+	if (tweens.id.empty()) return;
+
+	size_t n = tweens.id.size();
+
+	//evaluate everything first, independent of where the values go
+	for (size_t i = 0; i < n; ++i) {
+		float elapsed = std::min(tweens.elapsed[i] + dt, tweens.duration[i]);
+		tweens.elapsed[i] = elapsed;
+
+		float t = tweens.duration[i] > 0.f ? elapsed / tweens.duration[i] : 1.f;
+		tweens.value[i] = tweens.from[i] + (tweens.to[i] - tweens.from[i]) * ease(tweens.ease[i], t);
+	}
+
+	//transform fields are plain floats; component fields go through lua so native proxies see the write
+	lua_State* L = nullptr;
+	for (size_t i = 0; i < n; ++i) {
+		if (tweens.target[i] != nullptr) {
+			*tweens.target[i] = tweens.value[i];
+			continue;
+		}
+
+		if (L == nullptr) L = ComponentDB::get_state();
+		lua_rawgeti(L, LUA_REGISTRYINDEX, tweens.table_ref[i]);
+		lua_pushnumber(L, tweens.value[i]);
+		lua_setfield(L, -2, Interner::get_string(tweens.field[i]).c_str());
+		lua_pop(L, 1);
+	}
+
+	for (size_t i = n; i-- > 0;) {
+		if (tweens.elapsed[i] < tweens.duration[i]) continue;
+
+		if (tweens.on_complete[i] != LUA_NOREF) {
+			completed.emplace_back(tweens.on_complete[i], tweens.owner[i]);
+			tweens.on_complete[i] = LUA_NOREF;
+		}
+		remove(static_cast<uint32_t>(i));
+		++finished_last_frame;
+	}
+
+	if (completed.empty()) return;
+
+	//callbacks may start new tweens, which run from next frame
+	L = ComponentDB::get_state();
+	std::vector<std::pair<int, Actor*>> delivering;
+	delivering.swap(completed);
+	for (const auto& [ref, owner] : delivering) {
+		Actor::running_scope running(owner);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+		if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+			std::string e_msg = lua_tostring(L, -1);
+			std::replace(e_msg.begin(), e_msg.end(), '\\', '/');
+			cout << "\033[31m" << "Tween : " << e_msg << "\033[0m" << endl;
+			lua_pop(L, 1);
+		}
+		luaL_unref(L, LUA_REGISTRYINDEX, ref);
+	}
+}
+
+void TweenDB::release(Actor* a)
+{
+	const void* transform = &a->get_transform();
+	for (size_t i = tweens.id.size(); i-- > 0;) {
+		if (tweens.owner[i] == a || tweens.object[i] == transform)
+			remove(static_cast<uint32_t>(i));
+	}
+}
+
+void TweenDB::collect_stats(std::vector<std::pair<std::string, double>>& out)
+{
+	out.emplace_back("tweens", static_cast<double>(tweens.id.size()));
+	out.emplace_back("tweens_finished", static_cast<double>(finished_last_frame));
+}
+
+
+/* ------------------------ private ------------------------ */
+
+int TweenDB::lua_to(lua_State* L)
+{
+	const char* field_name = luaL_checkstring(L, 2);
+	float to = static_cast<float>(luaL_checknumber(L, 3));
+	float duration = static_cast<float>(luaL_checknumber(L, 4));
+	uint8_t e = lua_isnoneornil(L, 5) ? static_cast<uint8_t>(LINEAR) : find_easing(luaL_checkstring(L, 5));
+	if (e == EASING_COUNT)
+		return luaL_error(L, "Tween.To: unknown easing %s", lua_tostring(L, 5));
+	if (!lua_isnoneornil(L, 6))
+		luaL_checktype(L, 6, LUA_TFUNCTION);
+
+	const void* object = nullptr;
+	Actor* owner = nullptr;
+	float* target = nullptr;
+	int table_ref = LUA_NOREF;
+	float from = 0.f;
+
+	if (lua_istable(L, 1)) {
+		lua_getfield(L, 1, field_name);
+		if (!lua_isnumber(L, -1))
+			return luaL_error(L, "Tween.To: field %s is not a number", field_name);
+		from = static_cast<float>(lua_tonumber(L, -1));
+		lua_pop(L, 1);
+
+		LuaRef actor = LuaRef::fromStack(L, 1)["actor"];
+		if (actor.isUserdata()) owner = actor.cast<Actor*>();
+
+		object = lua_topointer(L, 1);
+		lua_pushvalue(L, 1);
+		table_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+	else {
+		Transform* t = luabridge::Stack<Transform*>::get(L, 1);
+		if (std::strcmp(field_name, "x") == 0) target = &t->position.x;
+		else if (std::strcmp(field_name, "y") == 0) target = &t->position.y;
+		else if (std::strcmp(field_name, "rotation") == 0) target = &t->rotation_deg;
+		else if (std::strcmp(field_name, "scale_x") == 0) target = &t->scale.x;
+		else if (std::strcmp(field_name, "scale_y") == 0) target = &t->scale.y;
+		else if (std::strcmp(field_name, "pivot_x") == 0) target = &t->pivot.x;
+		else if (std::strcmp(field_name, "pivot_y") == 0) target = &t->pivot.y;
+		else return luaL_error(L, "Tween.To: Transform has no field %s", field_name);
+
+		object = t;
+		from = *target;
+	}
+
+	uint32_t field = Interner::get_id(field_name);
+
+	//a new tween on the same field takes over from the old one
+	auto existing = by_target.find({ object, field });
+	if (existing != by_target.end()) {
+		auto row = rows.find(existing->second);
+		if (row != rows.end()) remove(row->second);
+	}
+
+	uint32_t id = next_id++;
+	rows.emplace(id, static_cast<uint32_t>(tweens.id.size()));
+	by_target[{ object, field }] = id;
+
+	tweens.id.push_back(id);
+	tweens.object.push_back(object);
+	tweens.owner.push_back(owner);
+	tweens.target.push_back(target);
+	tweens.table_ref.push_back(table_ref);
+	tweens.field.push_back(field);
+	tweens.from.push_back(from);
+	tweens.to.push_back(to);
+	tweens.elapsed.push_back(0.f);
+	tweens.duration.push_back(std::max(duration, 0.f));
+	tweens.ease.push_back(e);
+	tweens.value.push_back(from);
+
+	if (lua_isfunction(L, 6)) {
+		lua_pushvalue(L, 6);
+		tweens.on_complete.push_back(luaL_ref(L, LUA_REGISTRYINDEX));
+	}
+	else {
+		tweens.on_complete.push_back(LUA_NOREF);
+	}
+
+	lua_pushinteger(L, id);
+	return 1;
+}
+
+int TweenDB::lua_cancel(lua_State* L)
+{
+	auto row = rows.find(static_cast<uint32_t>(luaL_checkinteger(L, 1)));
+	if (row != rows.end()) remove(row->second);
+	return 0;
+}
+
+int TweenDB::lua_is_active(lua_State* L)
+{
+	lua_pushboolean(L, rows.find(static_cast<uint32_t>(luaL_checkinteger(L, 1))) != rows.end());
+	return 1;
+}
+
+uint8_t TweenDB::find_easing(const char* name)
+{
+	for (uint8_t e = 0; e < EASING_COUNT; ++e) {
+		if (std::strcmp(EASING_NAMES[e], name) == 0) return e;
+	}
+	return EASING_COUNT;
+}
+
+float TweenDB::ease(uint8_t e, float t)
+{
+	const float pi = 3.14159265f;
+	const float back = 1.70158f;
+	const float back_in_out = back * 1.525f;
+
+	auto bounce_out = [](float x) {
+		const float n = 7.5625f;
+		const float d = 2.75f;
+		if (x < 1.f / d) return n * x * x;
+		if (x < 2.f / d) { x -= 1.5f / d; return n * x * x + 0.75f; }
+		if (x < 2.5f / d) { x -= 2.25f / d; return n * x * x + 0.9375f; }
+		x -= 2.625f / d;
+		return n * x * x + 0.984375f;
+	};
+
+	switch (e) {
+	case IN_QUAD: return t * t;
+	case OUT_QUAD: return 1.f - (1.f - t) * (1.f - t);
+	case IN_OUT_QUAD: return t < 0.5f ? 2.f * t * t : 1.f - std::pow(-2.f * t + 2.f, 2.f) / 2.f;
+	case IN_CUBIC: return t * t * t;
+	case OUT_CUBIC: return 1.f - std::pow(1.f - t, 3.f);
+	case IN_OUT_CUBIC: return t < 0.5f ? 4.f * t * t * t : 1.f - std::pow(-2.f * t + 2.f, 3.f) / 2.f;
+	case IN_SINE: return 1.f - std::cos(t * pi / 2.f);
+	case OUT_SINE: return std::sin(t * pi / 2.f);
+	case IN_OUT_SINE: return -(std::cos(pi * t) - 1.f) / 2.f;
+	case IN_EXPO: return t <= 0.f ? 0.f : std::pow(2.f, 10.f * t - 10.f);
+	case OUT_EXPO: return t >= 1.f ? 1.f : 1.f - std::pow(2.f, -10.f * t);
+	case IN_OUT_EXPO:
+		if (t <= 0.f || t >= 1.f) return t;
+		return t < 0.5f ? std::pow(2.f, 20.f * t - 10.f) / 2.f : (2.f - std::pow(2.f, -20.f * t + 10.f)) / 2.f;
+	case IN_BACK: return (back + 1.f) * t * t * t - back * t * t;
+	case OUT_BACK: return 1.f + (back + 1.f) * std::pow(t - 1.f, 3.f) + back * std::pow(t - 1.f, 2.f);
+	case IN_OUT_BACK:
+		return t < 0.5f
+			? (std::pow(2.f * t, 2.f) * ((back_in_out + 1.f) * 2.f * t - back_in_out)) / 2.f
+			: (std::pow(2.f * t - 2.f, 2.f) * ((back_in_out + 1.f) * (t * 2.f - 2.f) + back_in_out) + 2.f) / 2.f;
+	case IN_ELASTIC:
+		if (t <= 0.f || t >= 1.f) return t;
+		return -std::pow(2.f, 10.f * t - 10.f) * std::sin((t * 10.f - 10.75f) * (2.f * pi / 3.f));
+	case OUT_ELASTIC:
+		if (t <= 0.f || t >= 1.f) return t;
+		return std::pow(2.f, -10.f * t) * std::sin((t * 10.f - 0.75f) * (2.f * pi / 3.f)) + 1.f;
+	case IN_BOUNCE: return 1.f - bounce_out(1.f - t);
+	case OUT_BOUNCE: return bounce_out(t);
+	case IN_OUT_BOUNCE: return t < 0.5f ? (1.f - bounce_out(1.f - 2.f * t)) / 2.f : (1.f + bounce_out(2.f * t - 1.f)) / 2.f;
+	default: return t;
+	}
+}
+
+void TweenDB::remove(uint32_t row)
+{
+	lua_State* L = ComponentDB::get_state();
+	if (tweens.table_ref[row] != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, tweens.table_ref[row]);
+	if (tweens.on_complete[row] != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, tweens.on_complete[row]);
+
+	auto key = by_target.find({ tweens.object[row], tweens.field[row] });
+	if (key != by_target.end() && key->second == tweens.id[row]) by_target.erase(key);
+	rows.erase(tweens.id[row]);
+
+	//the last row moves into this one
+	uint32_t last = static_cast<uint32_t>(tweens.id.size() - 1);
+	if (row != last) rows[tweens.id[last]] = row;
+
+	swap_remove(tweens.id, row);
+	swap_remove(tweens.object, row);
+	swap_remove(tweens.owner, row);
+	swap_remove(tweens.target, row);
+	swap_remove(tweens.table_ref, row);
+	swap_remove(tweens.field, row);
+	swap_remove(tweens.from, row);
+	swap_remove(tweens.to, row);
+	swap_remove(tweens.elapsed, row);
+	swap_remove(tweens.duration, row);
+	swap_remove(tweens.ease, row);
+	swap_remove(tweens.on_complete, row);
+	swap_remove(tweens.value, row);
+}
@@ -0,0 +1,102 @@
+#ifndef TWEEN_DB_H
+#define TWEEN_DB_H
+
+#include "Lua/lua.hpp"
+#include "LuaBridge/LuaBridge.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <cstdint>
+
+class Actor;
+
+//Tween.To(target, field, value, duration, [easing], [on_complete]): moves a Transform field or a numeric component
+//field to value over duration seconds. every tween is evaluated in one pass per frame and finished tweens'
+//callbacks are delivered together afterwards
+class TweenDB
+{
+public:
+	//registers the Tween namespace
+	static void add_functions(lua_State* state);
+
+	//advances, eases and writes every tween, then delivers completion callbacks
+	static void update(float dt);
+
+	//cancels tweens on a's transform or components (a is leaving the scene)
+	static void release(Actor* a);
+
+	static void collect_stats(std::vector<std::pair<std::string, double>>& out);
+
+private:
+	enum easing : uint8_t {
+		LINEAR,
+		IN_QUAD, OUT_QUAD, IN_OUT_QUAD,
+		IN_CUBIC, OUT_CUBIC, IN_OUT_CUBIC,
+		IN_SINE, OUT_SINE, IN_OUT_SINE,
+		IN_EXPO, OUT_EXPO, IN_OUT_EXPO,
+		IN_BACK, OUT_BACK, IN_OUT_BACK,
+		IN_ELASTIC, OUT_ELASTIC,
+		IN_BOUNCE, OUT_BOUNCE, IN_OUT_BOUNCE,
+		EASING_COUNT
+	};
+	static inline const char* const EASING_NAMES[EASING_COUNT] = {
+		"linear",
+		"in_quad", "out_quad", "in_out_quad",
+		"in_cubic", "out_cubic", "in_out_cubic",
+		"in_sine", "out_sine", "in_out_sine",
+		"in_expo", "out_expo", "in_out_expo",
+		"in_back", "out_back", "in_out_back",
+		"in_elastic", "out_elastic",
+		"in_bounce", "out_bounce", "in_out_bounce"
+	};
+
+	//one row per running tween
+	struct tween_columns {
+		std::vector<uint32_t> id;
+		std::vector<const void*> object;		//Transform* or the component table
+		std::vector<Actor*> owner;				//actor of a component table, if it has one
+		std::vector<float*> target;				//transform field, nullptr for tables
+		std::vector<int> table_ref;				//registry ref of the table, LUA_NOREF for transforms
+		std::vector<uint32_t> field;			//interned field name
+		std::vector<float> from;
+		std::vector<float> to;
+		std::vector<float> elapsed;
+		std::vector<float> duration;
+		std::vector<uint8_t> ease;
+		std::vector<int> on_complete;			//registry ref, LUA_NOREF if none
+		std::vector<float> value;				//eased value this frame
+	};
+
+	struct target_key {
+		const void* object;
+		uint32_t field;
+		bool operator==(const target_key& other) const { return object == other.object && field == other.field; }
+	};
+	struct target_key_hash {
+		size_t operator()(const target_key& k) const { return std::hash<const void*>()(k.object) ^ (static_cast<size_t>(k.field) * 0x9E3779B97F4A7C15ull); }
+	};
+
+	static inline tween_columns tweens;
+	static inline std::unordered_map<uint32_t, uint32_t> rows;				//id -> row
+	static inline std::unordered_map<target_key, uint32_t, target_key_hash> by_target;	//one tween per field, newest wins
+	static inline uint32_t next_id = 1;
+
+	static inline std::vector<std::pair<int, Actor*>> completed;	//callback refs waiting for delivery, with the tween's owner
+	static inline size_t finished_last_frame = 0;
+
+	//lua: id = Tween.To(target, field, value, duration, [easing], [on_complete]), Tween.Cancel(id), Tween.IsActive(id)
+	static int lua_to(lua_State* L);
+	static int lua_cancel(lua_State* L);
+	static int lua_is_active(lua_State* L);
+
+	static uint8_t find_easing(const char* name);
+	static float ease(uint8_t e, float t);
+
+	//removes row without running its callback
+	static void remove(uint32_t row);
+};
+
+#endif